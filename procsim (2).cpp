@@ -1,144 +1,168 @@
 #include "procsim.hpp"
+#include "procsim_log.hpp"
+#include "procsim_stats.hpp"
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 #include <cinttypes>
-#include <map>
 #include <vector>
 
-#include "procsim.hpp"
-#include <cstring>
-#include <algorithm>
-#include <cinttypes>
-#include <map>
-#include <vector>
-
-// Current simulation clock state
-uint64_t current_clock_cycle;
-uint64_t next_instruction_tag;
-bool trace_fetch_done;
-
-// Configuration parameters for processor components
-uint64_t instructions_per_cycle_fetch;           // Maximum instructions fetchable each cycle
-uint64_t number_of_result_buses;      // Total count of result broadcast buses available
-uint64_t functional_unit_type0_total;        // Quantity of functional units handling type 0 operations
-uint64_t functional_unit_type1_total;        // Quantity of functional units handling type 1 operations
-uint64_t functional_unit_type2_total;        // Quantity of functional units handling type 2 operations
-uint64_t reservation_station_max_capacity;
-
-// Data structures for instruction storage and tracking
-std::vector<proc_inst_t> fetched_instruction_buffer;           // Buffer holding newly fetched instructions
-std::vector<proc_inst_t> dispatch_instruction_queue;         // Queue of instructions waiting for reservation station slots
-std::vector<proc_inst_t> reservation_station_queue;      // Main reservation station holding scheduled instructions
-std::vector<uint64_t> functional_unit_type0_instruction_tags;
-std::vector<uint64_t> functional_unit_type1_instruction_tags;
-std::vector<uint64_t> functional_unit_type2_instruction_tags;
-std::map<int32_t, uint64_t> register_producer_tag_mapping;
-
-// Counters for tracking simulation statistics
-uint64_t total_instruction_count;
-uint64_t total_fired_instruction_count;
-uint64_t accumulated_dispatch_queue_size;
-uint64_t dispatch_queue_sample_count;
-
-// Sorting comparator for completed instructions prioritizing by fire cycle, then tag
-bool sort_by_fire_cycle_then_tag(const proc_inst_t* first_instruction, const proc_inst_t* second_instruction) {
-    if (first_instruction->fire_cycle != second_instruction->fire_cycle) {
-        return first_instruction->fire_cycle < second_instruction->fire_cycle;
-    } else {
-        return first_instruction->tag < second_instruction->tag;
-    }
-}
-
-// Sorting comparator for ready instructions based on tag order
-bool sort_by_instruction_tag(const proc_inst_t* first_instruction, const proc_inst_t* second_instruction) {
-    return first_instruction->tag < second_instruction->tag;
+const char* const proc_stage_names[PROC_STAGE_COUNT] = {
+    "completion", "fire", "schedule", "retire", "dispatch", "fetch"
+};
+
+// Runs one stage call, bracketed by the attached stage probe if there is one
+#define PROCSIM_RUN_STAGE(stage, stage_call) \
+    do { \
+        if (stage_probe == NULL) { \
+            stage_call; \
+        } else { \
+            stage_probe->begin_stage(stage); \
+            stage_call; \
+            stage_probe->end_stage(stage); \
+        } \
+    } while (0)
+
+// Functional unit type executing an op code, or -1 if no unit can execute it
+static inline int32_t functional_unit_type_of(int32_t op_code) {
+    if (op_code == -1) return 1;
+    if (op_code >= 0 && op_code <= 2) return op_code;
+    return -1;
 }
 
-// Predicate determining if instruction has completed and should be removed
-bool is_instruction_retired(const proc_inst_t& current_instruction) {
-    return current_instruction.complete_cycle > 0 && current_instruction.complete_cycle < current_clock_cycle;
+// Consumer links name one source operand of a waiting instruction
+static inline uint64_t make_consumer_link(uint64_t consumer_tag, int source_register_index) {
+    return (consumer_tag << 1) | (uint64_t)source_register_index;
 }
 
 /**
  * Completion Processing Stage
- * Identifies instructions that have finished execution and allocates result buses
+ * Allocates result buses to instructions that have finished executing, earliest finish cycle first
  * Returns collection of instruction tags being broadcast on result buses this cycle
  */
-std::vector<uint64_t> process_instruction_completion() {
-    // Identify all instructions that completed execution in previous cycle
-    std::vector<proc_inst_t*> list_of_completed_instructions;
-    
-    size_t loop_index = 0;
-    while (loop_index < reservation_station_queue.size()) {
-        if (reservation_station_queue[loop_index].fired && reservation_station_queue[loop_index].complete_cycle == 0 && current_clock_cycle > reservation_station_queue[loop_index].fire_cycle) {
-            list_of_completed_instructions.push_back(&reservation_station_queue[loop_index]);
-        }
-        loop_index++;
+template <typename shape_t>
+const std::vector<uint64_t>& proc_sim_t::process_instruction_completion() {
+    broadcast_instruction_tags.clear();
+
+    // Instructions finishing this cycle queue in tag order behind those denied a bus in earlier cycles
+    uint64_t& bucket_head = completion_wheel_head[current_clock_cycle & completion_wheel_mask];
+    for (uint64_t finished_tag = bucket_head; finished_tag != 0; finished_tag = station_completion_link[station_slot(finished_tag)]) {
+        result_bus_waiting_tags.push_back(finished_tag);
+        executing_instruction_count--;
     }
-
-    // Order completed instructions by fire time, breaking ties with instruction tag
-    std::sort(list_of_completed_instructions.begin(), list_of_completed_instructions.end(), sort_by_fire_cycle_then_tag);
+    bucket_head = 0;
+    if (result_bus_waiting_tags.empty()) return broadcast_instruction_tags;
 
     // Allocate available result buses and compile broadcast list
-    std::vector<uint64_t> tags_to_broadcast;
-    uint64_t result_buses_allocated = 0;
-
-    loop_index = 0;
-    while (loop_index < list_of_completed_instructions.size()) {
-        if (result_buses_allocated >= number_of_result_buses) break;
-        
-        proc_inst_t* current_instruction_ptr = list_of_completed_instructions[loop_index];
+    size_t result_buses_allocated = std::min((size_t)result_bus_count<shape_t>(), result_bus_waiting_tags.size());
+    for (size_t loop_index = 0; loop_index < result_buses_allocated; loop_index++) {
+        uint64_t completed_tag = result_bus_waiting_tags[loop_index];
+        uint64_t slot = station_slot(completed_tag);
+        proc_inst_t& completed_instruction = station_instruction[slot];
 
         // Record completion timestamp for this instruction
-        current_instruction_ptr->complete_cycle = current_clock_cycle;
-        tags_to_broadcast.push_back(current_instruction_ptr->tag);
-        result_buses_allocated++;
+        completed_instruction.complete_cycle = current_clock_cycle;
+        completed_instruction.state_update_cycle = current_clock_cycle;
+        completed_instruction.completed = true;
+        broadcast_instruction_tags.push_back(completed_tag);
 
         // Remove producer mapping if this instruction still owns the destination register
-        if (current_instruction_ptr->dest_reg >= 0 && current_instruction_ptr->dest_reg < 128) {
-            auto map_iterator = register_producer_tag_mapping.find(current_instruction_ptr->dest_reg);
-            if (map_iterator != register_producer_tag_mapping.end() && map_iterator->second == current_instruction_ptr->tag) {
-                register_producer_tag_mapping.erase(map_iterator);
-            }
+        if (is_renamed_register(completed_instruction.dest_reg) &&
+            register_producer_tag_mapping[completed_instruction.dest_reg] == completed_tag) {
+            register_producer_tag_mapping[completed_instruction.dest_reg] = 0;
         }
 
-        // Release the functional unit occupied by this instruction
-        int32_t functional_unit_type_id = current_instruction_ptr->op_code;
-        if (functional_unit_type_id == -1) functional_unit_type_id = 1;
+        // Release the functional unit occupied by this instruction; pipelined units were released after firing
+        int32_t functional_unit_type_id = station_fu_type[slot];
+        if (!functional_unit_pipelined[functional_unit_type_id]) {
+            int32_t fu_index = station_fu_index[slot];
+            functional_unit_free_bitmap[functional_unit_type_id][fu_index >> 6] |= 1ULL << (fu_index & 63);
+            functional_unit_free_count[functional_unit_type_id]++;
+        }
+    }
+    result_bus_waiting_tags.erase(result_bus_waiting_tags.begin(), result_bus_waiting_tags.begin() + result_buses_allocated);
 
-        if (functional_unit_type_id == 0) {
-            size_t fu_search_index = 0;
-            while (fu_search_index < functional_unit_type0_instruction_tags.size()) {
-                if (functional_unit_type0_instruction_tags[fu_search_index] == current_instruction_ptr->tag) {
-                    functional_unit_type0_instruction_tags[fu_search_index] = 0;
-                    break;
-                }
-                fu_search_index++;
-            }
-        } else if (functional_unit_type_id == 1) {
-            size_t fu_search_index = 0;
-            while (fu_search_index < functional_unit_type1_instruction_tags.size()) {
-                if (functional_unit_type1_instruction_tags[fu_search_index] == current_instruction_ptr->tag) {
-                    functional_unit_type1_instruction_tags[fu_search_index] = 0;
-                    break;
-                }
-                fu_search_index++;
-            }
-        } else if (functional_unit_type_id == 2) {
-            size_t fu_search_index = 0;
-            while (fu_search_index < functional_unit_type2_instruction_tags.size()) {
-                if (functional_unit_type2_instruction_tags[fu_search_index] == current_instruction_ptr->tag) {
-                    functional_unit_type2_instruction_tags[fu_search_index] = 0;
-                    break;
-                }
-                fu_search_index++;
-            }
+    return broadcast_instruction_tags;
+}
+
+/**
+ * Completion Scheduling
+ * Links a fired instruction into the wheel bucket of the cycle it finishes executing, keeping the bucket in tag order
+ */
+void proc_sim_t::schedule_completion(uint64_t tag, uint64_t finish_cycle) {
+    uint64_t* p_link = &completion_wheel_head[finish_cycle & completion_wheel_mask];
+    while (*p_link != 0 && *p_link < tag) {
+        p_link = &station_completion_link[station_slot(*p_link)];
+    }
+    station_completion_link[station_slot(tag)] = *p_link;
+    *p_link = tag;
+    executing_instruction_count++;
+}
+
+/**
+ * Functional Unit Pools
+ * Marks every unit of a type free
+ */
+void proc_sim_t::reset_functional_unit_pool(int32_t functional_unit_type_id) {
+    std::vector<uint64_t>& free_bitmap = functional_unit_free_bitmap[functional_unit_type_id];
+    uint64_t unit_total = functional_unit_type_id == 0 ? functional_unit_type0_total :
+                          functional_unit_type_id == 1 ? functional_unit_type1_total : functional_unit_type2_total;
+    for (size_t word_index = 0; word_index < free_bitmap.size(); word_index++) {
+        uint64_t word_units = std::min<uint64_t>(unit_total - word_index * 64, 64);
+        free_bitmap[word_index] = word_units == 64 ? ~0ULL : (1ULL << word_units) - 1;
+    }
+    functional_unit_free_count[functional_unit_type_id] = unit_total;
+}
+
+/**
+ * Ready tracking
+ * Records an instruction whose operands are all available in the ready bitmap of its unit type
+ */
+void proc_sim_t::mark_instruction_ready(uint64_t tag) {
+    int32_t functional_unit_type_id = station_fu_type[station_slot(tag)];
+    if (functional_unit_type_id < 0) return;
+    ready_instruction_bitmap[functional_unit_type_id].set(tag, reservation_station_oldest_tag);
+    ready_instruction_count[functional_unit_type_id]++;
+}
+
+/**
+ * Reservation station window growth
+ * Doubles the slot arrays until every tag from the oldest occupant to newest_tag has its own slot
+ */
+void proc_sim_t::grow_reservation_station_window(uint64_t newest_tag) {
+    uint64_t old_window_mask = station_window_mask;
+    uint64_t new_window_size = (old_window_mask + 1) * 2;
+    while (newest_tag - reservation_station_oldest_tag >= new_window_size) new_window_size *= 2;
+    uint64_t new_window_mask = new_window_size - 1;
+
+    std::vector<uint64_t> new_src_tag(new_window_size * 2);
+    std::vector<uint64_t> new_consumer_link(new_window_size * 3);
+    std::vector<uint64_t> new_completion_link(new_window_size);
+    std::vector<int32_t> new_fu_index(new_window_size);
+    std::vector<int8_t> new_fu_type(new_window_size);
+    std::vector<proc_inst_t> new_instruction(new_window_size);
+
+    for (uint64_t tag = reservation_station_oldest_tag; tag <= reservation_station_newest_tag; tag++) {
+        uint64_t old_slot = tag & old_window_mask;
+        uint64_t new_slot = tag & new_window_mask;
+        new_src_tag[new_slot * 2] = station_src_tag[old_slot * 2];
+        new_src_tag[new_slot * 2 + 1] = station_src_tag[old_slot * 2 + 1];
+        for (int link_index = 0; link_index < 3; link_index++) {
+            new_consumer_link[new_slot * 3 + link_index] = station_consumer_link[old_slot * 3 + link_index];
         }
-        
-        loop_index++;
+        new_completion_link[new_slot] = station_completion_link[old_slot];
+        new_fu_index[new_slot] = station_fu_index[old_slot];
+        new_fu_type[new_slot] = station_fu_type[old_slot];
+        new_instruction[new_slot] = station_instruction[old_slot];
     }
 
-    return tags_to_broadcast;
+    station_src_tag.swap(new_src_tag);
+    station_consumer_link.swap(new_consumer_link);
+    station_completion_link.swap(new_completion_link);
+    station_fu_index.swap(new_fu_index);
+    station_fu_type.swap(new_fu_type);
+    station_instruction.swap(new_instruction);
+    station_window_mask = new_window_mask;
 }
 
 /**
@@ -146,176 +170,289 @@ std::vector<uint64_t> process_instruction_completion() {
  * Transfers instructions from dispatch queue into reservation station with register renaming
  * Then broadcasts completed instruction tags to wake dependent instructions
  */
-void perform_scheduling_and_broadcast(const std::vector<uint64_t>& incoming_broadcast_tags) {
+template <typename shape_t>
+void proc_sim_t::perform_scheduling_and_broadcast(const std::vector<uint64_t>& incoming_broadcast_tags) {
     // Phase 1: Transfer instructions from dispatch queue to reservation station
     uint64_t available_reservation_slots;
-    if (reservation_station_queue.size() < reservation_station_max_capacity) {
-        available_reservation_slots = reservation_station_max_capacity - reservation_station_queue.size();
+    if (reservation_station_size < reservation_station_capacity<shape_t>()) {
+        available_reservation_slots = reservation_station_capacity<shape_t>() - reservation_station_size;
     } else {
         available_reservation_slots = 0;
     }
-    uint64_t number_to_dispatch = std::min(available_reservation_slots, (uint64_t)dispatch_instruction_queue.size());
+    uint64_t number_to_dispatch = std::min(available_reservation_slots, dispatch_queue_size());
+    if (number_to_dispatch > dispatch_instruction_queue.size()) {
+        refill_dispatch_queue(number_to_dispatch - dispatch_instruction_queue.size());
+    }
 
     for (uint64_t dispatch_loop_index = 0; dispatch_loop_index < number_to_dispatch; dispatch_loop_index++) {
-        proc_inst_t instruction_to_schedule = dispatch_instruction_queue[dispatch_loop_index];
+        const proc_inst_t& dispatched_instruction = dispatch_instruction_queue[dispatch_loop_index];
+        uint64_t tag = dispatched_instruction.tag;
+
+        // Claim the slot for this tag, widening the window if the oldest occupant would be overwritten
+        if (reservation_station_size == 0) {
+            reservation_station_oldest_tag = tag;
+        } else if (tag - reservation_station_oldest_tag > station_window_mask) {
+            grow_reservation_station_window(tag);
+        }
+        reservation_station_newest_tag = tag;
+        reservation_station_size++;
+        station_occupied_bitmap.set(tag, reservation_station_oldest_tag);
+
+        uint64_t slot = station_slot(tag);
+        proc_inst_t& instruction_to_schedule = station_instruction[slot];
+        instruction_to_schedule = dispatched_instruction;
         instruction_to_schedule.schedule_cycle = current_clock_cycle;
+        station_fu_type[slot] = (int8_t)functional_unit_type_of(instruction_to_schedule.op_code);
+        station_consumer_link[slot * 3] = 0;
 
         // Perform register renaming by looking up producer tags for source registers
         for (int source_register_index = 0; source_register_index < 2; source_register_index++) {
-            if (instruction_to_schedule.src_reg[source_register_index] >= 0 && instruction_to_schedule.src_reg[source_register_index] < 128) {
-                auto producer_map_iterator = register_producer_tag_mapping.find(instruction_to_schedule.src_reg[source_register_index]);
-                if (producer_map_iterator != register_producer_tag_mapping.end()) {
-                    instruction_to_schedule.src_tag[source_register_index] = producer_map_iterator->second;
-                } else {
-                    instruction_to_schedule.src_tag[source_register_index] = 0;
-                }
-            } else {
-                instruction_to_schedule.src_tag[source_register_index] = 0;
+            uint64_t producer_tag = 0;
+            if (is_renamed_register(instruction_to_schedule.src_reg[source_register_index])) {
+                producer_tag = register_producer_tag_mapping[instruction_to_schedule.src_reg[source_register_index]];
+            }
+            station_src_tag[slot * 2 + source_register_index] = producer_tag;
+            instruction_to_schedule.src_tag[source_register_index] = producer_tag;
+
+            // Queue this instruction on the consumer list of an in-flight producer
+            station_consumer_link[slot * 3 + 1 + source_register_index] = 0;
+            if (producer_tag != 0) {
+                uint64_t producer_slot = station_slot(producer_tag);
+                station_consumer_link[slot * 3 + 1 + source_register_index] = station_consumer_link[producer_slot * 3];
+                station_consumer_link[producer_slot * 3] = make_consumer_link(tag, source_register_index);
             }
         }
 
         // Register this instruction as the new producer for its destination register
-        if (instruction_to_schedule.dest_reg >= 0 && instruction_to_schedule.dest_reg < 128) {
-            register_producer_tag_mapping[instruction_to_schedule.dest_reg] = instruction_to_schedule.tag;
+        if (is_renamed_register(instruction_to_schedule.dest_reg)) {
+            register_producer_tag_mapping[instruction_to_schedule.dest_reg] = tag;
         }
 
-        reservation_station_queue.push_back(instruction_to_schedule);
+        if (station_src_tag[slot * 2] == 0 && station_src_tag[slot * 2 + 1] == 0) {
+            mark_instruction_ready(tag);
+        } else {
+            operand_wait_count++;
+        }
     }
 
     // Remove successfully scheduled instructions from dispatch queue
-    dispatch_instruction_queue.erase(dispatch_instruction_queue.begin(), dispatch_instruction_queue.begin() + number_to_dispatch);
+    dispatch_instruction_queue.pop_front(number_to_dispatch);
 
-    // Phase 2: Broadcast completed tags to wake up waiting instructions
+    // Phase 2: Broadcast completed tags to wake up the instructions registered as their consumers
     size_t broadcast_loop_index = 0;
     while (broadcast_loop_index < incoming_broadcast_tags.size()) {
         uint64_t broadcast_tag_value = incoming_broadcast_tags[broadcast_loop_index];
-        size_t reservation_station_index = 0;
-        while (reservation_station_index < reservation_station_queue.size()) {
-            if (!reservation_station_queue[reservation_station_index].fired) {
-                if (reservation_station_queue[reservation_station_index].src_tag[0] == broadcast_tag_value) {
-                    reservation_station_queue[reservation_station_index].src_tag[0] = 0;
-                }
-                if (reservation_station_queue[reservation_station_index].src_tag[1] == broadcast_tag_value) {
-                    reservation_station_queue[reservation_station_index].src_tag[1] = 0;
+        uint64_t producer_slot = station_slot(broadcast_tag_value);
+        uint64_t consumer_link = station_consumer_link[producer_slot * 3];
+        station_consumer_link[producer_slot * 3] = 0;
+
+        while (consumer_link != 0) {
+            int source_register_index = (int)(consumer_link & 1);
+            uint64_t consumer_tag = consumer_link >> 1;
+            uint64_t consumer_slot = station_slot(consumer_tag);
+            consumer_link = station_consumer_link[consumer_slot * 3 + 1 + source_register_index];
+            if (station_src_tag[consumer_slot * 2 + source_register_index] == broadcast_tag_value) {
+                station_src_tag[consumer_slot * 2 + source_register_index] = 0;
+                if (station_src_tag[consumer_slot * 2] == 0 && station_src_tag[consumer_slot * 2 + 1] == 0) {
+                    mark_instruction_ready(consumer_tag);
+                    operand_wait_count--;
                 }
             }
-            reservation_station_index++;
         }
         broadcast_loop_index++;
     }
+
+    if (stall_counters != NULL) record_schedule_stalls(1);
 }
 
 /**
  * Retirement Stage
  * Removes instructions from reservation station that finished in earlier cycles
  */
-void remove_completed_instructions() {
-    reservation_station_queue.erase(
-        std::remove_if(reservation_station_queue.begin(), reservation_station_queue.end(), is_instruction_retired),
-        reservation_station_queue.end()
-    );
+void proc_sim_t::remove_completed_instructions() {
+    for (uint64_t retired_tag : retiring_instruction_tags) {
+        station_occupied_bitmap.clear(retired_tag);
+    }
+    reservation_station_size -= retiring_instruction_tags.size();
+    if (!retiring_instruction_tags.empty()) last_retirement_cycle = current_clock_cycle;
+
+    // Advance the oldest occupant past any freed slots
+    if (reservation_station_size > 0 && !retiring_instruction_tags.empty()) {
+        station_occupied_bitmap.for_each_set(reservation_station_oldest_tag, reservation_station_newest_tag, [this](uint64_t occupied_tag) {
+            reservation_station_oldest_tag = occupied_tag;
+            return false;
+        });
+    }
+
+    // Retired slots are only reused by later tags, so log them before scheduling can overwrite them
+    if (event_log != NULL && !retiring_instruction_tags.empty()) {
+        log_retired_instructions(first_unretired_tag());
+    }
+
+    // This cycle's completions leave the reservation station next cycle
+    retiring_instruction_tags.swap(broadcast_instruction_tags);
+    broadcast_instruction_tags.clear();
 }
 
 /**
- * Execution Stage
- * Identifies ready instructions and allocates them to available functional units
+ * Event Logging
+ * Writes every instruction from the oldest unlogged tag up to end_tag, all of which have retired
  */
-void fire_ready_instructions_to_units() {
-    // Collect all instructions ready for execution
-    std::vector<proc_inst_t*> list_of_ready_instructions;
-
-    size_t reservation_search_index = 0;
-    while (reservation_search_index < reservation_station_queue.size()) {
-        if (reservation_station_queue[reservation_search_index].fired) {
-            reservation_search_index++;
-            continue;
-        }
+void proc_sim_t::log_retired_instructions(uint64_t end_tag) {
+    while (next_logged_tag < end_tag) {
+        pipeline_event_t event;
+        instruction_to_pipeline_event(station_instruction[station_slot(next_logged_tag)], &event);
+        event_log->append(event);
+        next_logged_tag++;
+    }
+}
+
+void proc_sim_t::attach_event_log(event_log_writer_t* log) {
+    // Instructions that retired before the log was attached are not logged
+    event_log = log;
+    next_logged_tag = first_unretired_tag();
+}
+
+void proc_sim_t::attach_stage_probe(stage_probe_t* probe) {
+    stage_probe = probe;
+}
 
-        bool source_operand_0_is_ready = (reservation_station_queue[reservation_search_index].src_reg[0] < 0) || (reservation_station_queue[reservation_search_index].src_tag[0] == 0) || (reservation_station_queue[reservation_search_index].src_tag[0] == reservation_station_queue[reservation_search_index].tag);
-        bool source_operand_1_is_ready = (reservation_station_queue[reservation_search_index].src_reg[1] < 0) || (reservation_station_queue[reservation_search_index].src_tag[1] == 0) || (reservation_station_queue[reservation_search_index].src_tag[1] == reservation_station_queue[reservation_search_index].tag);
+void proc_sim_t::attach_stall_counters(stall_counters_t* counters) {
+    stall_counters = counters;
+    stall_sampled_fired_count = total_fired_instruction_count;
+    if (stall_counters == NULL) return;
+
+    proc_config_t config;
+    config.result_buses = number_of_result_buses;
+    config.fu_type0 = functional_unit_type0_total;
+    config.fu_type1 = functional_unit_type1_total;
+    config.fu_type2 = functional_unit_type2_total;
+    config.fetch_width = instructions_per_cycle_fetch;
+    config.architectural_registers = architectural_register_count;
+    config.watchdog_cycles = watchdog_cycle_limit;
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        config.fu_latency[functional_unit_type_id] = functional_unit_latency[functional_unit_type_id];
+        config.fu_pipelined[functional_unit_type_id] = functional_unit_pipelined[functional_unit_type_id];
+    }
+    reset_stall_counters(stall_counters, config);
+}
 
-        if (source_operand_0_is_ready && source_operand_1_is_ready) {
-            list_of_ready_instructions.push_back(&reservation_station_queue[reservation_search_index]);
+/**
+ * Stall Attribution
+ * Each recorder charges the current state to cycle_count cycles, so idle
+ * cycles skipped in one step are accounted exactly as if each had run
+ */
+void proc_sim_t::record_fire_stalls(uint64_t cycle_count) {
+    // Anything still ready after firing found every unit of its type busy
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        if (ready_instruction_count[functional_unit_type_id] > 0) {
+            stall_counters->functional_unit_denied[functional_unit_type_id] += ready_instruction_count[functional_unit_type_id] * cycle_count;
+            stall_counters->functional_unit_denied_cycles[functional_unit_type_id] += cycle_count;
         }
-        reservation_search_index++;
     }
+}
 
-    // Order ready instructions by tag to maintain program order
-    std::sort(list_of_ready_instructions.begin(), list_of_ready_instructions.end(), sort_by_instruction_tag);
+void proc_sim_t::record_schedule_stalls(uint64_t cycle_count) {
+    // Scheduling takes as many queued instructions as fit, so any left over met a full reservation station
+    if (dispatch_queue_size() > 0) {
+        stall_counters->reservation_station_full_stalls += dispatch_queue_size() * cycle_count;
+        stall_counters->reservation_station_full_cycles += cycle_count;
+    }
+    stall_counters->operand_wait += operand_wait_count * cycle_count;
+}
 
-    // Attempt to allocate functional units to ready instructions
-    size_t ready_instruction_index = 0;
-    while (ready_instruction_index < list_of_ready_instructions.size()) {
-        proc_inst_t* instruction_pointer = list_of_ready_instructions[ready_instruction_index];
-        int32_t functional_unit_type_id = instruction_pointer->op_code;
-        if (functional_unit_type_id == -1) functional_unit_type_id = 1;
+void proc_sim_t::record_cycle_stalls(uint64_t cycle_count) {
+    // At the end of a cycle the waiting list holds every finished instruction denied a bus
+    uint64_t fired_count = total_fired_instruction_count - stall_sampled_fired_count;
+    uint64_t result_bus_denied_count = result_bus_waiting_tags.size();
+    stall_sampled_fired_count = total_fired_instruction_count;
 
-        bool functional_unit_was_allocated = false;
+    stall_counters->cycles += cycle_count;
+    if (result_bus_denied_count > 0) {
+        stall_counters->result_bus_denied += result_bus_denied_count * cycle_count;
+        stall_counters->result_bus_denied_cycles += cycle_count;
+    }
 
-        if (functional_unit_type_id == 0) {
-            size_t fu_allocation_index = 0;
-            while (fu_allocation_index < functional_unit_type0_instruction_tags.size()) {
-                if (functional_unit_type0_instruction_tags[fu_allocation_index] == 0) {
-                    functional_unit_type0_instruction_tags[fu_allocation_index] = instruction_pointer->tag;
-                    functional_unit_was_allocated = true;
-                    break;
-                }
-                fu_allocation_index++;
-            }
-        } else if (functional_unit_type_id == 1) {
-            size_t fu_allocation_index = 0;
-            while (fu_allocation_index < functional_unit_type1_instruction_tags.size()) {
-                if (functional_unit_type1_instruction_tags[fu_allocation_index] == 0) {
-                    functional_unit_type1_instruction_tags[fu_allocation_index] = instruction_pointer->tag;
-                    functional_unit_was_allocated = true;
-                    break;
-                }
-                fu_allocation_index++;
-            }
-        } else if (functional_unit_type_id == 2) {
-            size_t fu_allocation_index = 0;
-            while (fu_allocation_index < functional_unit_type2_instruction_tags.size()) {
-                if (functional_unit_type2_instruction_tags[fu_allocation_index] == 0) {
-                    functional_unit_type2_instruction_tags[fu_allocation_index] = instruction_pointer->tag;
-                    functional_unit_was_allocated = true;
-                    break;
-                }
-                fu_allocation_index++;
-            }
-        }
+    // This cycle's completions wait in the retiring list until next cycle's retirement
+    stall_counters->result_buses_used_histogram[retiring_instruction_tags.size()] += cycle_count;
+    stall_counters->fired_per_cycle_histogram[fired_count] += cycle_count;
+    stall_counters->reservation_station_histogram[reservation_station_size] += cycle_count;
+    stall_counters->dispatch_queue_histogram[dispatch_queue_histogram_bucket(dispatch_queue_size())] += cycle_count;
+}
 
-        if (functional_unit_was_allocated) {
-            instruction_pointer->fired = true;
-            instruction_pointer->fire_cycle = current_clock_cycle;
-            instruction_pointer->execute_cycle = current_clock_cycle;
+/**
+ * Execution Stage
+ * Fires ready instructions to available functional units, oldest first within each unit type
+ */
+template <typename shape_t>
+void proc_sim_t::fire_ready_instructions_to_units() {
+    if (reservation_station_size == 0) return;
+
+    // Unit types draw from disjoint pools, so selecting per type preserves global tag-order issue
+    for (int32_t functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        if (functional_unit_free_count[functional_unit_type_id] == 0) continue;
+
+        std::vector<uint64_t>& free_bitmap = functional_unit_free_bitmap[functional_unit_type_id];
+        tag_window_bitmap_t& ready_bitmap = ready_instruction_bitmap[functional_unit_type_id];
+        ready_bitmap.for_each_set(reservation_station_oldest_tag, reservation_station_newest_tag, [&](uint64_t ready_tag) {
+            uint64_t slot = station_slot(ready_tag);
+
+            // Allocate the lowest numbered free unit of this type
+            int64_t fu_allocation_index = find_first_set_bit(free_bitmap.data(), functional_unit_bitmap_words<shape_t>(functional_unit_type_id));
+            free_bitmap[fu_allocation_index >> 6] &= ~(1ULL << (fu_allocation_index & 63));
+            functional_unit_free_count[functional_unit_type_id]--;
+            ready_bitmap.clear(ready_tag);
+            ready_instruction_count[functional_unit_type_id]--;
+
+            station_fu_index[slot] = (int32_t)fu_allocation_index;
+            schedule_completion(ready_tag, current_clock_cycle + functional_unit_latency[functional_unit_type_id]);
+
+            proc_inst_t& fired_instruction = station_instruction[slot];
+            fired_instruction.fired = true;
+            fired_instruction.fire_cycle = current_clock_cycle;
+            fired_instruction.execute_cycle = current_clock_cycle;
             total_fired_instruction_count++;
-        }
-        ready_instruction_index++;
+
+            return functional_unit_free_count[functional_unit_type_id] > 0;
+        });
+
+        // A pipelined unit takes the next instruction in the following cycle
+        if (functional_unit_pipelined[functional_unit_type_id]) reset_functional_unit_pool(functional_unit_type_id);
     }
+
+    if (stall_counters != NULL) record_fire_stalls(1);
 }
 
 /**
  * Dispatch Stage
  * Transfers instructions from fetch buffer to dispatch queue with tag assignment
  */
-void move_instructions_to_dispatch_queue(proc_stats_t* statistics_pointer) {
+void proc_sim_t::move_instructions_to_dispatch_queue() {
     size_t fetch_buffer_index = 0;
     while (fetch_buffer_index < fetched_instruction_buffer.size()) {
-        fetched_instruction_buffer[fetch_buffer_index].dispatch_cycle = current_clock_cycle;
-        fetched_instruction_buffer[fetch_buffer_index].tag = next_instruction_tag++;
+        proc_inst_t& dispatched_instruction = dispatch_instruction_queue.push_back();
+        dispatched_instruction = fetched_instruction_buffer[fetch_buffer_index];
+        dispatched_instruction.dispatch_cycle = current_clock_cycle;
+        dispatched_instruction.tag = next_instruction_tag++;
         total_instruction_count++;
-        dispatch_instruction_queue.push_back(fetched_instruction_buffer[fetch_buffer_index]);
         fetch_buffer_index++;
     }
     fetched_instruction_buffer.clear();
 
+    // Deferred instructions queue up behind the resident ones without being stored
+    next_instruction_tag += fetched_deferred_count;
+    total_instruction_count += fetched_deferred_count;
+    deferred_instruction_count += fetched_deferred_count;
+    fetched_deferred_count = 0;
+
     // Update dispatch queue size metrics for statistics
-    if (dispatch_instruction_queue.size() > 0) {
-        accumulated_dispatch_queue_size += dispatch_instruction_queue.size();
+    uint64_t queue_size = dispatch_queue_size();
+    if (queue_size > 0) {
+        accumulated_dispatch_queue_size += queue_size;
         dispatch_queue_sample_count++;
     }
-    if (dispatch_instruction_queue.size() > statistics_pointer->max_disp_size) {
-        statistics_pointer->max_disp_size = dispatch_instruction_queue.size();
+    if (queue_size > max_dispatch_queue_size) {
+        max_dispatch_queue_size = queue_size;
     }
 }
 
@@ -323,13 +460,31 @@ void move_instructions_to_dispatch_queue(proc_stats_t* statistics_pointer) {
  * Fetch Stage
  * Reads new instructions from trace file into fetch buffer
  */
-void read_instructions_from_trace() {
+template <typename shape_t>
+void proc_sim_t::read_instructions_from_trace() {
     if (trace_fetch_done) return;
 
     uint64_t fetch_loop_index = 0;
-    while (fetch_loop_index < instructions_per_cycle_fetch) {
-        proc_inst_t new_instruction;
-        if (read_instruction(&new_instruction)) {
+    while (fetch_loop_index < fetch_width<shape_t>()) {
+        // Behind a full resident queue, only check that the instruction exists and count it
+        if (dispatch_queue_deferral_enabled &&
+            (deferred_instruction_count > 0 || fetched_deferred_count > 0 ||
+             dispatch_instruction_queue.size() + fetched_instruction_buffer.size() >= DISPATCH_QUEUE_RESIDENT_LIMIT)) {
+            if (deferred_instruction_count == 0 && fetched_deferred_count == 0) {
+                trace_source->tell(&deferred_trace_position);
+            }
+            proc_inst_t deferred_instruction;
+            if (!trace_source->read(&deferred_instruction)) {
+                trace_fetch_done = !trace_source->awaiting_instructions();
+                break;
+            }
+            fetched_deferred_count++;
+            fetch_loop_index++;
+            continue;
+        }
+
+        proc_inst_t& new_instruction = fetched_instruction_buffer.push_back();
+        if (trace_source->read(&new_instruction)) {
             new_instruction.fetch_cycle = current_clock_cycle;
             new_instruction.tag = 0;  // Tag assignment happens later in dispatch stage
             new_instruction.dispatch_cycle = 0;
@@ -337,110 +492,323 @@ void read_instructions_from_trace() {
             new_instruction.execute_cycle = 0;
             new_instruction.state_update_cycle = 0;
             new_instruction.fired = false;
+            new_instruction.completed = false;
             new_instruction.fire_cycle = 0;
             new_instruction.complete_cycle = 0;
             new_instruction.src_tag[0] = 0;
             new_instruction.src_tag[1] = 0;
-            fetched_instruction_buffer.push_back(new_instruction);
         } else {
-            trace_fetch_done = true;
+            fetched_instruction_buffer.pop_back();
+            trace_fetch_done = !trace_source->awaiting_instructions();
             break;
         }
         fetch_loop_index++;
     }
 }
 
-void setup_proc(uint64_t result_buses_param, uint64_t fu_type0_param, uint64_t fu_type1_param, uint64_t fu_type2_param, uint64_t fetch_width_param) {
+/**
+ * Deferred Instruction Refill
+ * Re-reads at least minimum_count deferred instructions from the trace into the resident dispatch queue
+ */
+void proc_sim_t::refill_dispatch_queue(uint64_t minimum_count) {
+    uint64_t refill_count = DISPATCH_QUEUE_RESIDENT_LIMIT > dispatch_instruction_queue.size() ?
+                            DISPATCH_QUEUE_RESIDENT_LIMIT - dispatch_instruction_queue.size() : 0;
+    refill_count = std::min(std::max(refill_count, minimum_count), deferred_instruction_count);
+
+    uint64_t fetch_position = 0;
+    bool repositioned = trace_source->tell(&fetch_position) && trace_source->seek(deferred_trace_position);
+
+    // Deferral needs a seekable source, and those never leave fetch awaiting instructions, so every
+    // instruction was fetched F per cycle from cycle 1 and dispatched the cycle after
+    uint64_t tag = next_instruction_tag - deferred_instruction_count;
+    for (uint64_t refill_index = 0; repositioned && refill_index < refill_count; refill_index++) {
+        proc_inst_t& refilled_instruction = dispatch_instruction_queue.push_back();
+        memset(&refilled_instruction, 0, sizeof(proc_inst_t));
+        if (!trace_source->read(&refilled_instruction)) {
+            repositioned = false;
+            break;
+        }
+        refilled_instruction.tag = tag;
+        refilled_instruction.fetch_cycle = (tag - 1) / instructions_per_cycle_fetch + 1;
+        refilled_instruction.dispatch_cycle = refilled_instruction.fetch_cycle + 1;
+        tag++;
+    }
+    repositioned = repositioned && trace_source->tell(&deferred_trace_position) && trace_source->seek(fetch_position);
+    if (!repositioned) {
+        fprintf(stderr, "Trace source failed to re-read deferred instructions\n");
+        exit(1);
+    }
+    deferred_instruction_count -= refill_count;
+}
+
+/**
+ * Idle Cycle Detection
+ * Returns the next cycle in which any stage can change pipeline state, or UINT64_MAX if none ever can
+ */
+template <typename shape_t>
+uint64_t proc_sim_t::find_next_event_cycle() const {
+    uint64_t next_cycle = current_clock_cycle + 1;
+
+    // Fetch and dispatch act every cycle until the trace and fetch buffer are exhausted
+    if (!trace_fetch_done || !fetched_instruction_buffer.empty()) return next_cycle;
+
+    // Finished instructions compete for result buses next cycle, and completions retire the cycle after
+    if (!result_bus_waiting_tags.empty() || !retiring_instruction_tags.empty()) return next_cycle;
+
+    // Waiting instructions can move only into free reservation station slots
+    if (dispatch_queue_size() > 0 && reservation_station_size < reservation_station_capacity<shape_t>()) return next_cycle;
+
+    // Ready instructions fire as soon as a unit of their type is free
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        if (ready_instruction_count[functional_unit_type_id] > 0 && functional_unit_free_count[functional_unit_type_id] > 0) return next_cycle;
+    }
+
+    // Otherwise nothing changes until the earliest executing instruction finishes
+    if (executing_instruction_count > 0) {
+        for (uint64_t finish_cycle = next_cycle; ; finish_cycle++) {
+            if (completion_wheel_head[finish_cycle & completion_wheel_mask] != 0) return finish_cycle;
+        }
+    }
+
+    // Anything left is waiting on a unit or operand that nothing in flight will ever provide
+    return UINT64_MAX;
+}
+
+/**
+ * Idle Cycle Accounting
+ * Applies the per-cycle statistics of cycles in which no stage changes pipeline state
+ */
+void proc_sim_t::skip_idle_cycles(uint64_t idle_cycle_count) {
+    // The dispatch queue holds still, so each skipped cycle samples the same occupancy
+    if (dispatch_queue_size() > 0) {
+        accumulated_dispatch_queue_size += dispatch_queue_size() * idle_cycle_count;
+        dispatch_queue_sample_count += idle_cycle_count;
+    }
+    current_clock_cycle += idle_cycle_count;
+
+    // Nothing fires, completes or moves, so every skipped cycle repeats the same stalls
+    if (stall_counters != NULL) {
+        record_fire_stalls(idle_cycle_count);
+        record_schedule_stalls(idle_cycle_count);
+        record_cycle_stalls(idle_cycle_count);
+    }
+}
+
+proc_sim_t::proc_sim_t(const proc_config_t& config, instruction_source* source) {
+    trace_source = source;
+
     // Initialize processor configuration from input parameters
-    number_of_result_buses = result_buses_param;
-    functional_unit_type0_total = fu_type0_param;
-    functional_unit_type1_total = fu_type1_param;
-    functional_unit_type2_total = fu_type2_param;
-    instructions_per_cycle_fetch = fetch_width_param;
+    number_of_result_buses = config.result_buses;
+    functional_unit_type0_total = config.fu_type0;
+    functional_unit_type1_total = config.fu_type1;
+    functional_unit_type2_total = config.fu_type2;
+    instructions_per_cycle_fetch = config.fetch_width;
+    uint64_t longest_latency = 1;
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        functional_unit_latency[functional_unit_type_id] = config.fu_latency[functional_unit_type_id];
+        functional_unit_pipelined[functional_unit_type_id] = config.fu_pipelined[functional_unit_type_id];
+        longest_latency = std::max(longest_latency, config.fu_latency[functional_unit_type_id]);
+    }
 
     // Compute reservation station size based on functional unit counts
-    reservation_station_max_capacity = 2 * (fu_type0_param + fu_type1_param + fu_type2_param);
-    
+    reservation_station_max_capacity = 2 * (config.fu_type0 + config.fu_type1 + config.fu_type2);
+
     // Reset all simulation state counters to initial values
     next_instruction_tag = 1;
-    current_clock_cycle = 0;
+    current_clock_cycle = 1;
+    simulation_finished = false;
+    watchdog_cycle_limit = config.watchdog_cycles;
+    last_retirement_cycle = 0;
+    watchdog_tripped = false;
     total_instruction_count = 0;
     total_fired_instruction_count = 0;
     accumulated_dispatch_queue_size = 0;
     dispatch_queue_sample_count = 0;
+    max_dispatch_queue_size = 0;
     trace_fetch_done = false;
-
-    // Empty all instruction storage structures
-    fetched_instruction_buffer.clear();
-    dispatch_instruction_queue.clear();
-    reservation_station_queue.clear();
-    register_producer_tag_mapping.clear();
-
-    // Allocate functional unit tracking arrays
-    functional_unit_type0_instruction_tags.assign(fu_type0_param, 0);
-    functional_unit_type1_instruction_tags.assign(fu_type1_param, 0);
-    functional_unit_type2_instruction_tags.assign(fu_type2_param, 0);
+    event_log = NULL;
+    stage_probe = NULL;
+    stall_counters = NULL;
+    stall_sampled_fired_count = 0;
+    next_logged_tag = 1;
+
+    // Deferring waiting instructions needs a source that can return to them
+    uint64_t initial_trace_position;
+    dispatch_queue_deferral_enabled = trace_source->tell(&initial_trace_position);
+    deferred_instruction_count = 0;
+    fetched_deferred_count = 0;
+    deferred_trace_position = 0;
+
+    // Preallocate the pipeline queues. Only the dispatch queue can outgrow its initial size, doubling
+    // until it holds the backlog (at most DISPATCH_QUEUE_RESIDENT_LIMIT once deferral is enabled);
+    // past that the cycle loop makes no heap allocations
+    uint64_t initial_window_size = 64;
+    while (initial_window_size < 4 * reservation_station_max_capacity) initial_window_size *= 2;
+    fetched_instruction_buffer.reset(instructions_per_cycle_fetch);
+    dispatch_instruction_queue.reset(initial_window_size);
+
+    station_window_mask = initial_window_size - 1;
+    station_src_tag.assign(initial_window_size * 2, 0);
+    station_consumer_link.assign(initial_window_size * 3, 0);
+    station_completion_link.assign(initial_window_size, 0);
+    station_fu_index.assign(initial_window_size, 0);
+    station_fu_type.assign(initial_window_size, 0);
+    station_instruction.assign(initial_window_size, proc_inst_t());
+    station_occupied_bitmap.reset(initial_window_size);
+    reservation_station_size = 0;
+    reservation_station_oldest_tag = 0;
+    reservation_station_newest_tag = 0;
+    operand_wait_count = 0;
+
+    // Buckets reach from the current cycle to the longest latency ahead, so the wheel never wraps onto a live one
+    uint64_t completion_wheel_size = 1;
+    while (completion_wheel_size <= longest_latency) completion_wheel_size *= 2;
+    completion_wheel_mask = completion_wheel_size - 1;
+    completion_wheel_head.assign(completion_wheel_size, 0);
+    executing_instruction_count = 0;
+
+    // Everything in flight holds a reservation station slot, so the per-cycle tag lists never outgrow its capacity
+    result_bus_waiting_tags.reserve(reservation_station_max_capacity);
+    broadcast_instruction_tags.reserve(std::min(number_of_result_buses, reservation_station_max_capacity));
+    retiring_instruction_tags.reserve(std::min(number_of_result_buses, reservation_station_max_capacity));
+
+    // Every architectural register starts with its value available
+    architectural_register_count = config.architectural_registers;
+    register_producer_tag_mapping.assign(architectural_register_count, 0);
+
+    // Allocate functional unit tracking bitmaps with every unit free
+    const uint64_t functional_unit_totals[3] = { config.fu_type0, config.fu_type1, config.fu_type2 };
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        functional_unit_free_bitmap[functional_unit_type_id].assign((functional_unit_totals[functional_unit_type_id] + 63) / 64, 0);
+        reset_functional_unit_pool(functional_unit_type_id);
+        ready_instruction_count[functional_unit_type_id] = 0;
+        ready_instruction_bitmap[functional_unit_type_id].reset(initial_window_size);
+    }
 }
 
-void run_proc(proc_stats_t* processor_statistics) {
-    current_clock_cycle = 1;
-
-    while (true) {
+template <typename shape_t>
+bool proc_sim_t::run_cycles(proc_stats_t* processor_statistics, uint64_t last_cycle, uint64_t retired_count) {
+    while (!simulation_finished && current_clock_cycle <= last_cycle && first_unretired_tag() <= retired_count) {
         // Execute all pipeline stages in correct sequential order
-        // Phase 1: Handle completion and result bus allocation
-        std::vector<uint64_t> broadcasted_tags = process_instruction_completion();
-        fire_ready_instructions_to_units();
+        // Phase 1: Handle completion and result bus allocation (fills broadcast_instruction_tags)
+        PROCSIM_RUN_STAGE(STAGE_COMPLETION, process_instruction_completion<shape_t>());
+        PROCSIM_RUN_STAGE(STAGE_FIRE, fire_ready_instructions_to_units<shape_t>());
         
         // Phase 3: Schedule new instructions and broadcast results
-        perform_scheduling_and_broadcast(broadcasted_tags);
+        PROCSIM_RUN_STAGE(STAGE_SCHEDULE, perform_scheduling_and_broadcast<shape_t>(broadcast_instruction_tags));
         
         // Phase 4: Clean up finished instructions
-        remove_completed_instructions();
+        PROCSIM_RUN_STAGE(STAGE_RETIRE, remove_completed_instructions());
         
         // Phase 5: Transfer fetched instructions to dispatch queue
-        move_instructions_to_dispatch_queue(processor_statistics);
+        PROCSIM_RUN_STAGE(STAGE_DISPATCH, move_instructions_to_dispatch_queue());
         
         // Phase 6: Fetch new instructions from trace
-        read_instructions_from_trace();
+        PROCSIM_RUN_STAGE(STAGE_FETCH, read_instructions_from_trace<shape_t>());
 
         // Terminate simulation when all instructions processed
-        if (trace_fetch_done && dispatch_instruction_queue.empty() && reservation_station_queue.empty()) {
+        if (trace_fetch_done && dispatch_queue_size() == 0 && reservation_station_size == 0) {
+            simulation_finished = true;
+            break;
+        }
+
+        // Nothing has retired for the whole watchdog period: the configuration cannot drain the trace
+        if (current_clock_cycle >= watchdog_deadline()) {
+            watchdog_tripped = true;
+            simulation_finished = true;
             break;
         }
 
-        // Emergency termination to prevent infinite execution
-        if (current_clock_cycle > 1000000) {
+        // The final cycle above is not part of the reported cycle count (cycle_count - 1), so it is not sampled;
+        // it only retires what already completed and records no stall
+        if (stall_counters != NULL) record_cycle_stalls(1);
+
+        // Stop at the end of the cycle that retired the requested instructions
+        if (first_unretired_tag() > retired_count) {
+            current_clock_cycle++;
             break;
         }
 
+        // Fast-forward over quiescent cycles, stopping no later than the cycle that would trip the
+        // watchdog or the first cycle after last_cycle
+        uint64_t next_event_cycle = std::min(find_next_event_cycle<shape_t>(), watchdog_deadline());
+        if (last_cycle < next_event_cycle - 1) {
+            next_event_cycle = last_cycle + 1;
+        }
+        if (next_event_cycle > current_clock_cycle + 1) {
+            skip_idle_cycles(next_event_cycle - current_clock_cycle - 1);
+        }
+
         current_clock_cycle++;
     }
 
-    // Record final simulation cycle count
+    // Record the final cycle count, or the next cycle to run if paused
     processor_statistics->cycle_count = current_clock_cycle;
+    processor_statistics->max_disp_size = max_dispatch_queue_size;
+    return simulation_finished;
+}
+
+// True if the configuration matches the compile-time shape
+template <typename shape_t>
+static bool matches_shape(uint64_t result_buses, uint64_t fu_type0, uint64_t fu_type1, uint64_t fu_type2, uint64_t fetch_width) {
+    return result_buses == shape_t::result_buses && fu_type0 == shape_t::fu_type0 && fu_type1 == shape_t::fu_type1 &&
+           fu_type2 == shape_t::fu_type2 && fetch_width == shape_t::fetch_width;
+}
+
+bool proc_sim_t::has_specialized_kernel() const {
+#define PROCSIM_MATCH_SHAPE(R, K0, K1, K2, F) \
+    if (matches_shape<static_shape_t<R, K0, K1, K2, F> >(number_of_result_buses, functional_unit_type0_total, \
+            functional_unit_type1_total, functional_unit_type2_total, instructions_per_cycle_fetch)) return true;
+    PROCSIM_SPECIALIZED_SHAPES(PROCSIM_MATCH_SHAPE)
+#undef PROCSIM_MATCH_SHAPE
+    return false;
+}
+
+void proc_sim_t::run(proc_stats_t* processor_statistics) {
+    run_until(processor_statistics, UINT64_MAX);
+}
+
+bool proc_sim_t::run_until(proc_stats_t* processor_statistics, uint64_t last_cycle) {
+    return run_shape(processor_statistics, last_cycle, UINT64_MAX);
+}
+
+bool proc_sim_t::run_until_retired(proc_stats_t* processor_statistics, uint64_t retired_count) {
+    return run_shape(processor_statistics, UINT64_MAX, retired_count);
+}
+
+bool proc_sim_t::run_shape(proc_stats_t* processor_statistics, uint64_t last_cycle, uint64_t retired_count) {
+    // Use the specialized kernel registered for this configuration, if any
+#define PROCSIM_RUN_SHAPE(R, K0, K1, K2, F) \
+    if (matches_shape<static_shape_t<R, K0, K1, K2, F> >(number_of_result_buses, functional_unit_type0_total, \
+            functional_unit_type1_total, functional_unit_type2_total, instructions_per_cycle_fetch)) { \
+        return run_cycles<static_shape_t<R, K0, K1, K2, F> >(processor_statistics, last_cycle, retired_count); \
+    }
+    PROCSIM_SPECIALIZED_SHAPES(PROCSIM_RUN_SHAPE)
+#undef PROCSIM_RUN_SHAPE
+
+    return run_cycles<runtime_shape_t>(processor_statistics, last_cycle, retired_count);
 }
 
-void complete_proc(proc_stats_t* final_statistics) {
+void proc_sim_t::complete(proc_stats_t* final_statistics) const {
     // Populate total retired instruction count
     final_statistics->retired_instruction = total_instruction_count;
 
     // Calculate average instructions per cycle metrics
     bool valid_cycle_count = (final_statistics->cycle_count > 0);
     if (valid_cycle_count) {
-        float total_cycles_as_float = (float)final_statistics->cycle_count;
-        final_statistics->avg_inst_fired = (float)total_fired_instruction_count / total_cycles_as_float;
-        final_statistics->avg_inst_retired = (float)total_instruction_count / total_cycles_as_float;
+        double total_cycles = (double)final_statistics->cycle_count;
+        final_statistics->avg_inst_fired = (double)total_fired_instruction_count / total_cycles;
+        final_statistics->avg_inst_retired = (double)total_instruction_count / total_cycles;
     } else {
-        final_statistics->avg_inst_fired = 0.0f;
-        final_statistics->avg_inst_retired = 0.0f;
+        final_statistics->avg_inst_fired = 0.0;
+        final_statistics->avg_inst_retired = 0.0;
     }
 
     // Calculate average dispatch queue occupancy
     bool has_dispatch_samples = (dispatch_queue_sample_count > 0);
     if (has_dispatch_samples) {
-        float sample_count_as_float = (float)dispatch_queue_sample_count;
-        final_statistics->avg_disp_size = (float)accumulated_dispatch_queue_size / sample_count_as_float;
+        final_statistics->avg_disp_size = (double)accumulated_dispatch_queue_size / (double)dispatch_queue_sample_count;
     } else {
-        final_statistics->avg_disp_size = 0.0f;
+        final_statistics->avg_disp_size = 0.0;
     }
 }
@@ -1,17 +1,36 @@
 #ifndef PROCSIM_HPP
 #define PROCSIM_HPP
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <queue>
 #include <vector>
 #include <deque>
 
+#include "procsim_bitmap.hpp"
+#include "procsim_ring.hpp"
+
 #define DEFAULT_K0 1
 #define DEFAULT_K1 2
 #define DEFAULT_K2 3
 #define DEFAULT_R 8
 #define DEFAULT_F 4
+#define DEFAULT_ARCH_REGS 128
+#define DEFAULT_WATCHDOG_CYCLES 1000000
+#define DEFAULT_FU_LATENCY 1
+
+// Longest functional unit latency a configuration may ask for
+#define MAX_FU_LATENCY 1024
+
+// Most architectural registers a configuration may have; trace records hold register ids as int16_t
+#define MAX_ARCH_REGS 32767
+
+// Most result buses, functional units of one type or fetch width a configuration may have
+#define MAX_PIPELINE_WIDTH 4096
+
+// Waiting instructions the dispatch queue keeps in memory before deferring the rest to the trace source
+#define DISPATCH_QUEUE_RESIDENT_LIMIT 65536
 
 typedef struct _proc_inst_t
 {
@@ -19,7 +38,7 @@ typedef struct _proc_inst_t
     int32_t op_code;
     int32_t src_reg[2];
     int32_t dest_reg;
-    
+
     // You may introduce other fields as needed
     uint64_t tag;                  // Instruction tag (sequential counter)
     bool src_ready[2];             // Ready bits for source registers
@@ -34,23 +53,369 @@ typedef struct _proc_inst_t
     uint64_t state_update_cycle;   // Cycle when instruction updates state
     bool fired;                    // Has instruction been fired?
     bool completed;                // Has execution completed?
-    
+
 } proc_inst_t;
 
 typedef struct _proc_stats_t
 {
-    float avg_inst_retired;
-    float avg_inst_fired;
-    float avg_disp_size;
-    unsigned long max_disp_size;
-    unsigned long retired_instruction;
-    unsigned long cycle_count;
+    double avg_inst_retired;
+    double avg_inst_fired;
+    double avg_disp_size;
+    uint64_t max_disp_size;
+    uint64_t retired_instruction;
+    uint64_t cycle_count;
 } proc_stats_t;
 
+//
+// stall_counters_t
+//
+//  Per-cycle stall attribution filled in by the stages of an attached
+//  simulator. Stall counts are instruction-cycles (one instruction held
+//  back for one cycle counts once); the matching *_cycles counters count
+//  cycles in which at least one instruction was held back.
+//
+typedef struct _stall_counters_t
+{
+    uint64_t cycles;
+
+    // Executing instructions denied a result bus by process_instruction_completion
+    uint64_t result_bus_denied;
+    uint64_t result_bus_denied_cycles;
+
+    // Ready instructions denied a functional unit, per unit type
+    uint64_t functional_unit_denied[3];
+    uint64_t functional_unit_denied_cycles[3];
+
+    // Dispatch queue instructions held back by a full reservation station
+    uint64_t reservation_station_full_stalls;
+    uint64_t reservation_station_full_cycles;
+
+    // Scheduled instructions waiting on a source operand
+    uint64_t operand_wait;
+
+    // Cycles by occupancy at the end of the cycle / by activity during it
+    std::vector<uint64_t> reservation_station_histogram;
+    std::vector<uint64_t> dispatch_queue_histogram;
+    std::vector<uint64_t> result_buses_used_histogram;
+    std::vector<uint64_t> fired_per_cycle_histogram;
+} stall_counters_t;
+
+// Processor configuration (R, k0, k1, k2, F)
+typedef struct _proc_config_t
+{
+    uint64_t result_buses;
+    uint64_t fu_type0;
+    uint64_t fu_type1;
+    uint64_t fu_type2;
+    uint64_t fetch_width;
+    uint64_t architectural_registers;   // Registers 0..n-1 are renamed; others never carry dependencies
+    uint64_t watchdog_cycles;           // Cycles without a retirement before a run is abandoned
+    uint64_t fu_latency[3];             // Cycles from firing until the result may take a bus, per FU type (1..MAX_FU_LATENCY)
+    bool fu_pipelined[3];               // Unit takes a new instruction every cycle instead of being held until its result is broadcast
+} proc_config_t;
+
+//
+// Machine shapes
+//
+//  Stage kernels are instantiated per shape. runtime_shape_t reads every
+//  loop bound from the configuration; static_shape_t fixes (R, k0, k1, k2,
+//  F) at compile time so the compiler can unroll the result bus, functional
+//  unit and fetch loops and keep each unit pool in a single bitmap word.
+//
+struct runtime_shape_t
+{
+    static const bool is_static = false;
+    static const uint64_t result_buses = 0;
+    static const uint64_t fu_type0 = 0;
+    static const uint64_t fu_type1 = 0;
+    static const uint64_t fu_type2 = 0;
+    static const uint64_t fetch_width = 0;
+};
+
+template <uint64_t R, uint64_t K0, uint64_t K1, uint64_t K2, uint64_t F>
+struct static_shape_t
+{
+    static_assert(K0 <= 64 && K1 <= 64 && K2 <= 64, "static shapes keep each unit pool in one bitmap word");
+
+    static const bool is_static = true;
+    static const uint64_t result_buses = R;
+    static const uint64_t fu_type0 = K0;
+    static const uint64_t fu_type1 = K1;
+    static const uint64_t fu_type2 = K2;
+    static const uint64_t fetch_width = F;
+};
+
+//
+// Configurations with compile-time specialized kernels, as X(R, k0, k1, k2, F);
+// any other configuration runs the runtime_shape_t kernels
+//
+#define PROCSIM_SPECIALIZED_SHAPES(X) \
+    X(DEFAULT_R, DEFAULT_K0, DEFAULT_K1, DEFAULT_K2, DEFAULT_F)   /* Baseline */ \
+    X(DEFAULT_R, DEFAULT_K0, DEFAULT_K1, DEFAULT_K2, 8)           /* N = 8 */ \
+    X(4, DEFAULT_K0, DEFAULT_K1, DEFAULT_K2, DEFAULT_F)           /* R = 4 */ \
+    X(4, DEFAULT_K0, DEFAULT_K1, DEFAULT_K2, 8)                   /* N = 8, R = 4 */
+
+class event_log_writer_t;
+
+// Stage functions run() calls once per cycle, in call order
+enum proc_stage_t
+{
+    STAGE_COMPLETION,
+    STAGE_FIRE,
+    STAGE_SCHEDULE,
+    STAGE_RETIRE,
+    STAGE_DISPATCH,
+    STAGE_FETCH,
+    PROC_STAGE_COUNT
+};
+
+extern const char* const proc_stage_names[PROC_STAGE_COUNT];
+
+// Observer bracketing every stage call made by run(), e.g. to time the stages
+class stage_probe_t
+{
+public:
+    virtual ~stage_probe_t() {}
+
+    virtual void begin_stage(proc_stage_t stage) = 0;
+    virtual void end_stage(proc_stage_t stage) = 0;
+};
+
+// Source of trace instructions pulled by the fetch stage
+class instruction_source
+{
+public:
+    virtual ~instruction_source() {}
+
+    // Populates the trace fields of p_inst, returns false at end of trace
+    virtual bool read(proc_inst_t* p_inst) = 0;
+
+    // Position of the next record, for checkpoints; false if the source cannot report one
+    virtual bool tell(uint64_t* p_position) { (void)p_position; return false; }
+
+    // Moves to a position from tell() so the next read returns that record
+    virtual bool seek(uint64_t position) { (void)position; return false; }
+
+    // True if the last failed read only found no instruction yet rather than the end of the
+    // trace; fetch then stalls for the cycle and tries again on the next one. Only sources
+    // without tell() may stall fetch.
+    virtual bool awaiting_instructions() const { return false; }
+};
+
+//
+// proc_sim_t
+//
+//  Self-contained simulator instance; every piece of pipeline state lives
+//  here so independent instances can run concurrently on separate threads
+//
+class proc_sim_t
+{
+public:
+    proc_sim_t(const proc_config_t& config, instruction_source* source);
+
+    void run(proc_stats_t* processor_statistics);
+
+    // Runs through the end of last_cycle at most; returns true once the simulation has finished.
+    // A paused simulator resumes with bit-identical results on the next call.
+    bool run_until(proc_stats_t* processor_statistics, uint64_t last_cycle);
+
+    // Runs until the oldest retired_count instructions have all retired, or the simulation finishes;
+    // returns true once it has finished
+    bool run_until_retired(proc_stats_t* processor_statistics, uint64_t retired_count);
+
+    // Live progress: instructions retired in tag order, cycles fully simulated, instructions fired
+    uint64_t retired_instruction_count() const { return first_unretired_tag() - 1; }
+    uint64_t simulated_cycle_count() const { return simulation_finished ? current_clock_cycle : current_clock_cycle - 1; }
+    uint64_t fired_instruction_count() const { return total_fired_instruction_count; }
+
+    // Trace position of the oldest instruction held only as a count, if any; the simulator may seek back to it
+    bool deferred_trace_start(uint64_t* p_position) const
+    {
+        if (deferred_instruction_count == 0 && fetched_deferred_count == 0) return false;
+        *p_position = deferred_trace_position;
+        return true;
+    }
+
+    // True if the run was abandoned because nothing retired for watchdog_cycles cycles
+    bool watchdog_expired() const { return watchdog_tripped; }
+    void complete(proc_stats_t* final_statistics) const;
+
+    // True if run() uses a compile-time specialized kernel for this configuration
+    bool has_specialized_kernel() const;
+
+    // Streams a pipeline event per retired instruction, in tag order, to log (NULL disables)
+    void attach_event_log(event_log_writer_t* log);
+
+    // Writes the complete simulator state and trace position; the simulator must be paused or finished
+    bool save_checkpoint(FILE* checkpoint_file);
+
+    // Replaces the state of a freshly constructed simulator with the same configuration from a
+    // checkpoint and seeks the trace source to the saved position
+    bool restore_checkpoint(FILE* checkpoint_file);
+
+    // Brackets each stage call in run() with probe callbacks (NULL disables)
+    void attach_stage_probe(stage_probe_t* probe);
+
+    // Resets counters and accumulates stall attribution into them during run() (NULL disables)
+    void attach_stall_counters(stall_counters_t* counters);
+
+private:
+    bool run_shape(proc_stats_t* processor_statistics, uint64_t last_cycle, uint64_t retired_count);
+    template <typename shape_t> bool run_cycles(proc_stats_t* processor_statistics, uint64_t last_cycle, uint64_t retired_count);
+    template <typename shape_t> const std::vector<uint64_t>& process_instruction_completion();
+    template <typename shape_t> void perform_scheduling_and_broadcast(const std::vector<uint64_t>& incoming_broadcast_tags);
+    void remove_completed_instructions();
+    template <typename shape_t> void fire_ready_instructions_to_units();
+    void move_instructions_to_dispatch_queue();
+    template <typename shape_t> void read_instructions_from_trace();
+    void refill_dispatch_queue(uint64_t minimum_count);
+    void mark_instruction_ready(uint64_t tag);
+    void grow_reservation_station_window(uint64_t newest_tag);
+    void reset_functional_unit_pool(int32_t functional_unit_type_id);
+    void schedule_completion(uint64_t tag, uint64_t finish_cycle);
+    template <typename shape_t> uint64_t find_next_event_cycle() const;
+    void skip_idle_cycles(uint64_t idle_cycle_count);
+    bool restored_state_consistent() const;
+    void log_retired_instructions(uint64_t end_tag);
+    void record_fire_stalls(uint64_t cycle_count);
+    void record_schedule_stalls(uint64_t cycle_count);
+    void record_cycle_stalls(uint64_t cycle_count);
+
+    // Loop bounds for a shape: compile-time constants for static shapes, configuration values otherwise
+    template <typename shape_t> uint64_t result_bus_count() const {
+        return shape_t::is_static ? shape_t::result_buses : number_of_result_buses;
+    }
+    template <typename shape_t> uint64_t fetch_width() const {
+        return shape_t::is_static ? shape_t::fetch_width : instructions_per_cycle_fetch;
+    }
+    template <typename shape_t> uint64_t reservation_station_capacity() const {
+        return shape_t::is_static ? 2 * (shape_t::fu_type0 + shape_t::fu_type1 + shape_t::fu_type2) : reservation_station_max_capacity;
+    }
+    template <typename shape_t> size_t functional_unit_bitmap_words(int32_t functional_unit_type_id) const {
+        return shape_t::is_static ? 1 : functional_unit_free_bitmap[functional_unit_type_id].size();
+    }
+
+    // True for register numbers tracked by the rename table (-1 and out-of-range numbers are not)
+    bool is_renamed_register(int32_t register_number) const {
+        return (uint32_t)register_number < architectural_register_count;
+    }
+
+    // Oldest tag still in the reservation station or not yet scheduled
+    uint64_t first_unretired_tag() const {
+        return reservation_station_size > 0 ? reservation_station_oldest_tag : reservation_station_newest_tag + 1;
+    }
+
+    // Waiting instructions, resident or deferred
+    uint64_t dispatch_queue_size() const {
+        return dispatch_instruction_queue.size() + deferred_instruction_count;
+    }
+
+    // First cycle in which the watchdog trips unless something retires first
+    uint64_t watchdog_deadline() const {
+        return last_retirement_cycle + std::min(watchdog_cycle_limit, UINT64_MAX - last_retirement_cycle);
+    }
+
+    // Reservation station slot holding an in-flight tag
+    uint64_t station_slot(uint64_t tag) const {
+        return tag & station_window_mask;
+    }
+
+    instruction_source* trace_source;
+
+    // Current simulation clock state
+    uint64_t current_clock_cycle;
+    uint64_t next_instruction_tag;
+    bool trace_fetch_done;
+    bool simulation_finished;
+    uint64_t watchdog_cycle_limit;
+    uint64_t last_retirement_cycle;
+    bool watchdog_tripped;
+
+    // Configuration parameters for processor components
+    uint64_t instructions_per_cycle_fetch;           // Maximum instructions fetchable each cycle
+    uint64_t number_of_result_buses;      // Total count of result broadcast buses available
+    uint64_t functional_unit_type0_total;        // Quantity of functional units handling type 0 operations
+    uint64_t functional_unit_type1_total;        // Quantity of functional units handling type 1 operations
+    uint64_t functional_unit_type2_total;        // Quantity of functional units handling type 2 operations
+    uint64_t functional_unit_latency[3];         // Cycles from firing until the result may take a bus, per type
+    bool functional_unit_pipelined[3];           // Units of the type are free again the cycle after firing
+    uint64_t reservation_station_max_capacity;
+
+    // Pipeline queues between fetch, dispatch and scheduling
+    ring_buffer_t<proc_inst_t> fetched_instruction_buffer;           // Buffer holding newly fetched instructions
+    ring_buffer_t<proc_inst_t> dispatch_instruction_queue;         // Queue of instructions waiting for reservation station slots
+
+    // Past DISPATCH_QUEUE_RESIDENT_LIMIT waiting instructions, the dispatch
+    // queue holds only a count of the newest ones and the trace position of
+    // the oldest of them; scheduling re-reads them from the trace source when
+    // it reaches them. Needs a source that can tell and seek.
+    bool dispatch_queue_deferral_enabled;
+    uint64_t deferred_instruction_count;   // Dispatched instructions behind the resident queue
+    uint64_t fetched_deferred_count;       // Fetched instructions behind the fetch buffer
+    uint64_t deferred_trace_position;      // Trace position of the oldest deferred instruction
+
+    // Reservation station slots, indexed by tag modulo the window size. The
+    // hot per-cycle fields are kept in separate arrays from the cold
+    // trace fields and stage timestamps in station_instruction.
+    uint64_t station_window_mask;
+    std::vector<uint64_t> station_src_tag;          // [slot * 2 + i]: producer tag source i waits on, 0 once available
+    std::vector<uint64_t> station_consumer_link;    // [slot * 3]: consumer list head, [slot * 3 + 1 + i]: next consumer after source i
+    std::vector<uint64_t> station_completion_link;  // [slot]: next tag finishing execution in the same cycle, 0 at the end
+    std::vector<int32_t> station_fu_index;          // Functional unit held while executing
+    std::vector<int8_t> station_fu_type;            // Functional unit type, -1 if no unit executes the op code
+    std::vector<proc_inst_t> station_instruction;   // Cold trace fields and stage timestamps
+    tag_window_bitmap_t station_occupied_bitmap;
+    uint64_t reservation_station_size;
+    uint64_t reservation_station_oldest_tag;
+    uint64_t reservation_station_newest_tag;
+    uint64_t operand_wait_count;   // Scheduled instructions still waiting on a source operand
+
+    // Completion scheduler: a timing wheel holding, for each cycle in which
+    // fired instructions finish executing, their tags linked in tag order
+    // through station_completion_link. Result bus arbitration only looks at
+    // the bucket of the current cycle and at instructions denied a bus before.
+    uint64_t completion_wheel_mask;
+    std::vector<uint64_t> completion_wheel_head;        // [cycle & mask]: first tag finishing that cycle, 0 if none
+    uint64_t executing_instruction_count;               // Fired instructions still in the wheel
+    std::vector<uint64_t> result_bus_waiting_tags;      // Finished and denied a result bus, by finish cycle then tag
+    std::vector<uint64_t> broadcast_instruction_tags;   // Completed this cycle
+    std::vector<uint64_t> retiring_instruction_tags;    // Completed last cycle, freed by this cycle's retirement
+
+    std::vector<uint64_t> functional_unit_free_bitmap[3];   // One bit per functional unit of each type, set while free
+    uint64_t functional_unit_free_count[3];
+    tag_window_bitmap_t ready_instruction_bitmap[3];      // Unfired instructions with all operands available, per FU type
+    uint64_t ready_instruction_count[3];
+
+    uint64_t architectural_register_count;
+    std::vector<uint64_t> register_producer_tag_mapping;   // In-flight producer tag per register, 0 once the value is available
+
+    event_log_writer_t* event_log;
+    stage_probe_t* stage_probe;
+    stall_counters_t* stall_counters;
+    uint64_t stall_sampled_fired_count;   // total_fired_instruction_count at the last end-of-cycle sample
+    uint64_t next_logged_tag;   // Oldest retired instruction not yet written to the event log
+
+    // Counters for tracking simulation statistics
+    uint64_t total_instruction_count;
+    uint64_t total_fired_instruction_count;
+    uint64_t accumulated_dispatch_queue_size;
+    uint64_t dispatch_queue_sample_count;
+    uint64_t max_dispatch_queue_size;
+};
+
 bool read_instruction(proc_inst_t* p_inst);
 
 void setup_proc(uint64_t result_buses_param, uint64_t fu_type0_param, uint64_t fu_type1_param, uint64_t fu_type2_param, uint64_t fetch_width_param);
+void setup_proc(const proc_config_t& config);
+void setup_proc(const proc_config_t& config, instruction_source* source);
+void setup_proc_event_log(event_log_writer_t* log);
+void setup_proc_stage_probe(stage_probe_t* probe);
+void setup_proc_stall_counters(stall_counters_t* counters);
 void run_proc(proc_stats_t* processor_statistics);
+bool run_proc_until(proc_stats_t* processor_statistics, uint64_t last_cycle);
+bool proc_watchdog_expired();
+bool save_proc_checkpoint(const char* path);
+bool restore_proc_checkpoint(const char* path);
 void complete_proc(proc_stats_t* final_statistics);
 
 #endif /* PROCSIM_HPP */
\ No newline at end of file
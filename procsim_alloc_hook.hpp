@@ -0,0 +1,17 @@
+#ifndef PROCSIM_ALLOC_HOOK_HPP
+#define PROCSIM_ALLOC_HOOK_HPP
+
+#include <cstdint>
+
+//
+// Heap allocation counting
+//
+//  Linking procsim_alloc_hook.o replaces the global operator new with one
+//  that counts every call, so a harness can check that a stretch of
+//  simulation allocated nothing. Only programs that link it are affected.
+//
+
+// operator new calls on any thread since the program started
+uint64_t heap_allocation_count();
+
+#endif /* PROCSIM_ALLOC_HOOK_HPP */
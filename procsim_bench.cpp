@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "procsim.hpp"
+#include "procsim_alloc_hook.hpp"
+#include "procsim_ctrace.hpp"
+#include "procsim_log.hpp"
+#include "procsim_synth.hpp"
+#include "procsim_trace.hpp"
+
+//
+// procsim_bench
+//
+//  Times run_proc over a fixed set of traces and configurations and prints
+//  one JSON object per (trace, configuration) pair on stdout
+//
+
+// Instructions in each built-in synthetic trace
+#define BENCH_TRACE_LENGTH 1000000
+
+// Cycles simulated between heap allocation samples with -A
+#define ALLOCATION_CHECK_CHUNK_CYCLES 1024
+
+typedef struct _bench_trace_t
+{
+    std::string name;
+    std::vector<trace_record_t> records;
+} bench_trace_t;
+
+typedef struct _bench_config_t
+{
+    const char* name;
+    proc_config_t config;
+} bench_config_t;
+
+// Trace replayed by read_instruction during the current run
+static memory_trace_source* active_trace_source = NULL;
+
+bool read_instruction(proc_inst_t* p_inst)
+{
+    return active_trace_source->read(p_inst);
+}
+
+static uint64_t monotonic_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//
+// stage_timer_t
+//
+//  Accumulates wall-clock time spent inside each stage function
+//
+class stage_timer_t : public stage_probe_t
+{
+public:
+    stage_timer_t() : stage_start_ns(0) { memset(stage_ns, 0, sizeof(stage_ns)); }
+
+    void begin_stage(proc_stage_t) { stage_start_ns = monotonic_ns(); }
+    void end_stage(proc_stage_t stage) { stage_ns[stage] += monotonic_ns() - stage_start_ns; }
+
+    uint64_t stage_ns[PROC_STAGE_COUNT];
+
+private:
+    uint64_t stage_start_ns;
+};
+
+static proc_config_t make_config(uint64_t r, uint64_t k0, uint64_t k1, uint64_t k2, uint64_t f)
+{
+    proc_config_t config;
+    config.result_buses = r;
+    config.fu_type0 = k0;
+    config.fu_type1 = k1;
+    config.fu_type2 = k2;
+    config.fetch_width = f;
+    config.architectural_registers = DEFAULT_ARCH_REGS;
+    config.watchdog_cycles = DEFAULT_WATCHDOG_CYCLES;
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        config.fu_latency[functional_unit_type_id] = DEFAULT_FU_LATENCY;
+        config.fu_pipelined[functional_unit_type_id] = false;
+    }
+    return config;
+}
+
+// Baseline units with multi-cycle type 1 and type 2 execution, type 2 pipelined
+static proc_config_t make_long_latency_config()
+{
+    proc_config_t config = make_config(DEFAULT_R, DEFAULT_K0, DEFAULT_K1, DEFAULT_K2, DEFAULT_F);
+    config.fu_latency[1] = 3;
+    config.fu_latency[2] = 4;
+    config.fu_pipelined[2] = true;
+    return config;
+}
+
+// Fixed-seed synthetic trace; register_span and mean distance set how much ILP it has
+static void make_synthetic_bench_trace(bench_trace_t& trace, const char* name, uint64_t seed,
+                                       uint64_t register_span, double mean_dependency_distance)
+{
+    synthetic_trace_config_t config;
+    default_synthetic_trace_config(&config);
+    config.seed = seed;
+    config.register_count = register_span;
+    config.mean_dependency_distance = mean_dependency_distance;
+
+    trace.name = name;
+    generate_synthetic_trace(config, BENCH_TRACE_LENGTH, trace.records);
+}
+
+static bool load_bench_trace(bench_trace_t& trace, const char* path)
+{
+    trace.name = path;
+    if (is_binary_trace_file(path)) {
+        mapped_trace_t mapped_trace;
+        if (!mapped_trace.open(path)) return false;
+        trace.records.assign(mapped_trace.records(), mapped_trace.records() + mapped_trace.size());
+        return true;
+    }
+    if (is_compressed_trace_file(path)) {
+        return load_compressed_trace(path, trace.records);
+    }
+
+    FILE* trace_file = fopen(path, "r");
+    if (trace_file == NULL) {
+        fprintf(stderr, "Failed to open %s for reading\n", path);
+        return false;
+    }
+    bool loaded = load_text_trace(trace_file, trace.records);
+    fclose(trace_file);
+    return loaded;
+}
+
+// Runs one configuration over a trace, returning the host time spent in run_proc
+static uint64_t time_run(const bench_trace_t& trace, const proc_config_t& config, stage_probe_t* probe, proc_stats_t* stats)
+{
+    memory_trace_source source(trace.records.data(), trace.records.size());
+    active_trace_source = &source;
+
+    setup_proc(config);
+    setup_proc_stage_probe(probe);
+    memset(stats, 0, sizeof(proc_stats_t));
+
+    uint64_t start_ns = monotonic_ns();
+    run_proc(stats);
+    uint64_t elapsed_ns = monotonic_ns() - start_ns;
+
+    complete_proc(stats);
+    active_trace_source = NULL;
+    return elapsed_ns;
+}
+
+// True if runs of config use a compile-time specialized kernel rather than the generic one
+static bool uses_specialized_kernel(const proc_config_t& config)
+{
+    memory_trace_source source(NULL, 0);
+    proc_sim_t simulator(config, &source);
+    return simulator.has_specialized_kernel();
+}
+
+//
+// count_steady_state_allocations
+//
+//  Runs one configuration in chunks with an event log and stall counters
+//  attached and returns the heap allocations made in steady state. A chunk
+//  is warm-up while the dispatch queue sets a new high-water mark below
+//  DISPATCH_QUEUE_RESIDENT_LIMIT, since the queue is still growing to hold
+//  the backlog; every other chunk is steady state.
+//
+static uint64_t count_steady_state_allocations(const bench_trace_t& trace, const proc_config_t& config,
+                                               uint64_t* p_steady_cycles)
+{
+    memory_trace_source source(trace.records.data(), trace.records.size());
+    proc_sim_t simulator(config, &source);
+
+    event_log_writer_t event_log;
+    if (!event_log.open("/dev/null")) exit(1);
+    simulator.attach_event_log(&event_log);
+    stall_counters_t stall_counters;
+    simulator.attach_stall_counters(&stall_counters);
+
+    proc_stats_t stats;
+    memset(&stats, 0, sizeof(proc_stats_t));
+    uint64_t steady_allocations = 0;
+    *p_steady_cycles = 0;
+    bool finished = false;
+    while (!finished) {
+        uint64_t chunk_start_cycle = simulator.simulated_cycle_count();
+        uint64_t high_water_before = stats.max_disp_size;
+        uint64_t allocations_before = heap_allocation_count();
+        finished = simulator.run_until(&stats, chunk_start_cycle + ALLOCATION_CHECK_CHUNK_CYCLES);
+        uint64_t chunk_allocations = heap_allocation_count() - allocations_before;
+
+        if (stats.max_disp_size > high_water_before && high_water_before < DISPATCH_QUEUE_RESIDENT_LIMIT) continue;
+        steady_allocations += chunk_allocations;
+        *p_steady_cycles += simulator.simulated_cycle_count() - chunk_start_cycle;
+    }
+    return steady_allocations;
+}
+
+//
+// check_steady_state_allocations
+//
+//  Reports steady-state heap allocations for every trace and configuration;
+//  returns nonzero if any were made
+//
+static int check_steady_state_allocations(const std::vector<bench_trace_t>& traces, const bench_config_t* configs,
+                                          size_t config_count)
+{
+    int exit_status = 0;
+    for (const bench_trace_t& trace : traces) {
+        for (size_t config_index = 0; config_index < config_count; config_index++) {
+            uint64_t steady_cycles;
+            uint64_t allocations = count_steady_state_allocations(trace, configs[config_index].config, &steady_cycles);
+            printf("%-24s %-9s %10" PRIu64 " steady-state cycles %6" PRIu64 " allocations%s\n", trace.name.c_str(),
+                   configs[config_index].name, steady_cycles, allocations, allocations > 0 ? "  FAILED" : "");
+            if (allocations > 0) exit_status = 1;
+        }
+    }
+    return exit_status;
+}
+
+void print_help_and_exit(void) {
+    printf("procsim_bench [OPTIONS] [trace files...]\n");
+    printf("  -n reps\tTimed repetitions per trace and configuration (default 5)\n");
+    printf("  -w runs\tUntimed warm-up runs (default 1)\n");
+    printf("  -A\t\tInstead of timing, fail if any run allocates heap memory in steady state\n");
+    printf("  -h\t\tThis helpful output\n");
+    printf("Without trace files, fixed synthetic traces of %d instructions are used\n", BENCH_TRACE_LENGTH);
+    exit(0);
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    int repetitions = 5;
+    int warmup_runs = 1;
+    bool check_allocations = false;
+
+    while (-1 != (opt = getopt(argc, argv, "n:w:Ah"))) {
+        switch (opt) {
+        case 'n':
+            repetitions = std::max(1, atoi(optarg));
+            break;
+        case 'w':
+            warmup_runs = std::max(0, atoi(optarg));
+            break;
+        case 'A':
+            check_allocations = true;
+            break;
+        case 'h':
+        default:
+            print_help_and_exit();
+            break;
+        }
+    }
+
+    std::vector<bench_trace_t> traces;
+    if (optind < argc) {
+        for (int arg_index = optind; arg_index < argc; arg_index++) {
+            traces.push_back(bench_trace_t());
+            if (!load_bench_trace(traces.back(), argv[arg_index])) return 1;
+        }
+    } else {
+        traces.resize(3);
+        make_synthetic_bench_trace(traces[0], "synthetic-high-ilp", 1, 128, 32.0);
+        make_synthetic_bench_trace(traces[1], "synthetic-mixed", 2, 32, 4.0);
+        make_synthetic_bench_trace(traces[2], "synthetic-serial", 3, 8, 1.0);
+    }
+
+    // README configurations plus a wide machine and one with multi-cycle units
+    const bench_config_t configs[] = {
+        { "baseline", make_config(DEFAULT_R, DEFAULT_K0, DEFAULT_K1, DEFAULT_K2, DEFAULT_F) },
+        { "n8",       make_config(DEFAULT_R, DEFAULT_K0, DEFAULT_K1, DEFAULT_K2, 8) },
+        { "r4",       make_config(4, DEFAULT_K0, DEFAULT_K1, DEFAULT_K2, DEFAULT_F) },
+        { "n8_r4",    make_config(4, DEFAULT_K0, DEFAULT_K1, DEFAULT_K2, 8) },
+        { "wide",     make_config(16, 16, 16, 16, 16) },
+        { "latency",  make_long_latency_config() },
+    };
+    if (check_allocations) {
+        return check_steady_state_allocations(traces, configs, sizeof(configs) / sizeof(configs[0]));
+    }
+
+    for (const bench_trace_t& trace : traces) {
+        for (const bench_config_t& bench_config : configs) {
+            proc_stats_t stats;
+            for (int run_index = 0; run_index < warmup_runs; run_index++) {
+                time_run(trace, bench_config.config, NULL, &stats);
+            }
+
+            std::vector<uint64_t> run_ns;
+            for (int run_index = 0; run_index < repetitions; run_index++) {
+                run_ns.push_back(time_run(trace, bench_config.config, NULL, &stats));
+            }
+            std::sort(run_ns.begin(), run_ns.end());
+            uint64_t median_ns = run_ns[run_ns.size() / 2];
+
+            // Stage breakdown comes from a separate probed run so probing never skews the timed runs
+            stage_timer_t stage_timer;
+            uint64_t probed_ns = time_run(trace, bench_config.config, &stage_timer, &stats);
+
+            bool specialized = uses_specialized_kernel(bench_config.config);
+            double simulated_cycles = (double)stats.cycle_count;
+            printf("{\"trace\":\"%s\",\"config\":\"%s\",\"specialized\":%s,\"R\":%" PRIu64 ",\"k0\":%" PRIu64 ",\"k1\":%" PRIu64
+                   ",\"k2\":%" PRIu64 ",\"F\":%" PRIu64 ",\"instructions\":%" PRIu64 ",\"cycles\":%" PRIu64 ",\"repetitions\":%d,"
+                   "\"median_ns\":%" PRIu64 ",\"min_ns\":%" PRIu64 ",\"max_ns\":%" PRIu64 ","
+                   "\"inst_per_sec\":%.1f,\"ns_per_cycle\":%.3f,\"probed_ns\":%" PRIu64 ",\"stage_ns\":{",
+                   trace.name.c_str(), bench_config.name, specialized ? "true" : "false", bench_config.config.result_buses,
+                   bench_config.config.fu_type0, bench_config.config.fu_type1, bench_config.config.fu_type2,
+                   bench_config.config.fetch_width, stats.retired_instruction, stats.cycle_count - 1, repetitions,
+                   median_ns, run_ns.front(), run_ns.back(),
+                   (double)stats.retired_instruction * 1e9 / (double)median_ns,
+                   (double)median_ns / simulated_cycles, probed_ns);
+            for (int stage = 0; stage < PROC_STAGE_COUNT; stage++) {
+                printf("%s\"%s\":%" PRIu64, stage == 0 ? "" : ",", proc_stage_names[stage], stage_timer.stage_ns[stage]);
+            }
+            printf("}}\n");
+            fflush(stdout);
+
+            fprintf(stderr, "%-24s %-9s %12.0f inst/s %8.2f ns/cycle  %s kernel\n", trace.name.c_str(), bench_config.name,
+                    (double)stats.retired_instruction * 1e9 / (double)median_ns, (double)median_ns / simulated_cycles,
+                    specialized ? "specialized" : "generic");
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+#ifndef PROCSIM_BITMAP_HPP
+#define PROCSIM_BITMAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Index of the lowest set bit across a multi-word bitmap, or -1 if none is set
+inline int64_t find_first_set_bit(const uint64_t* bitmap_words, size_t word_count)
+{
+    for (size_t word_index = 0; word_index < word_count; word_index++) {
+        if (bitmap_words[word_index] != 0) {
+            return (int64_t)(word_index * 64 + __builtin_ctzll(bitmap_words[word_index]));
+        }
+    }
+    return -1;
+}
+
+//
+// tag_window_bitmap_t
+//
+//  One bit per instruction tag over a sliding window of tags. Bits are kept
+//  in a ring of 64-bit words addressed by tag, so scanning the words from
+//  the oldest live tag upward visits set tags in age order. The window
+//  grows whenever the live span (oldest_tag..tag) would wrap the ring.
+//
+class tag_window_bitmap_t
+{
+public:
+    tag_window_bitmap_t() : word_mask(0) {}
+
+    void reset(uint64_t initial_tag_span)
+    {
+        size_t word_count = 1;
+        while (word_count * 64 < initial_tag_span) word_count <<= 1;
+        ring_words.assign(word_count, 0);
+        word_mask = word_count - 1;
+    }
+
+    // Sets the bit for tag; every set bit must be at or after oldest_tag
+    void set(uint64_t tag, uint64_t oldest_tag)
+    {
+        if ((tag >> 6) - (oldest_tag >> 6) > word_mask) {
+            grow(oldest_tag, tag);
+        }
+        ring_words[(tag >> 6) & word_mask] |= 1ULL << (tag & 63);
+    }
+
+    void clear(uint64_t tag)
+    {
+        ring_words[(tag >> 6) & word_mask] &= ~(1ULL << (tag & 63));
+    }
+
+    //
+    // for_each_set
+    //
+    //  Visits set tags in [first_tag, last_tag] oldest first; the visitor
+    //  returns false to stop the scan early
+    //
+    template <typename visitor_t>
+    void for_each_set(uint64_t first_tag, uint64_t last_tag, visitor_t visitor) const
+    {
+        if (last_tag < first_tag) return;
+        uint64_t first_word = first_tag >> 6;
+        uint64_t last_word = last_tag >> 6;
+        if (last_word - first_word > word_mask) {
+            // Bits past one full ring from first_tag cannot be set
+            last_word = first_word + word_mask;
+            last_tag = (last_word << 6) | 63;
+        }
+        for (uint64_t word_number = first_word; word_number <= last_word; word_number++) {
+            uint64_t pending_bits = ring_words[word_number & word_mask];
+            if (word_number == first_word) pending_bits &= ~0ULL << (first_tag & 63);
+            if (word_number == last_word && (last_tag & 63) != 63) pending_bits &= (1ULL << ((last_tag & 63) + 1)) - 1;
+            while (pending_bits != 0) {
+                uint64_t tag = (word_number << 6) | (uint64_t)__builtin_ctzll(pending_bits);
+                pending_bits &= pending_bits - 1;
+                if (!visitor(tag)) return;
+            }
+        }
+    }
+
+    // Raw ring words, for checkpoints; restoring them reproduces the exact window layout
+    const std::vector<uint64_t>& words() const { return ring_words; }
+    void assign_words(const std::vector<uint64_t>& words)
+    {
+        ring_words = words;
+        word_mask = ring_words.size() - 1;
+    }
+
+private:
+    // Doubles the ring until oldest_tag..newest_tag fits, keeping live words in place by tag
+    void grow(uint64_t oldest_tag, uint64_t newest_tag)
+    {
+        uint64_t first_word = oldest_tag >> 6;
+        size_t word_count = ring_words.size();
+        size_t new_word_count = word_count;
+        while ((newest_tag >> 6) - first_word >= new_word_count) new_word_count <<= 1;
+
+        std::vector<uint64_t> new_ring_words(new_word_count, 0);
+        for (uint64_t word_number = first_word; word_number < first_word + word_count; word_number++) {
+            new_ring_words[word_number & (new_word_count - 1)] = ring_words[word_number & word_mask];
+        }
+        ring_words.swap(new_ring_words);
+        word_mask = new_word_count - 1;
+    }
+
+    std::vector<uint64_t> ring_words;
+    uint64_t word_mask;
+};
+
+#endif /* PROCSIM_BITMAP_HPP */
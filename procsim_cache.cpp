@@ -0,0 +1,321 @@
+#include "procsim_cache.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <map>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Eviction trims the directory to this fraction of its limit, so a full cache is not rescanned on every store
+#define RESULT_CACHE_EVICT_TARGET 0.9
+
+// Temporary files older than this are left over from interrupted writers and removed by eviction
+#define RESULT_CACHE_STALE_TEMP_SECONDS 3600
+
+static inline uint64_t rotate_left(uint64_t value, int shift)
+{
+    return (value << shift) | (value >> (64 - shift));
+}
+
+static inline uint64_t final_mix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+void content_hasher_t::mix_word(uint64_t word)
+{
+    lane[0] = rotate_left(lane[0] ^ (word * 0x87c37b91114253d5ULL), 31) * 0x9e3779b97f4a7c15ULL;
+    lane[1] = rotate_left(lane[1] + (word * 0x4cf5ad432745937fULL), 33) * 0xc2b2ae3d27d4eb4fULL + 0x52dce729;
+}
+
+void content_hasher_t::update(const void* data, size_t length)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    total_length += length;
+
+    // Complete a partial word left by the previous update first
+    while (length > 0 && pending_byte_count > 0) {
+        pending_bytes |= (uint64_t)*bytes++ << (8 * pending_byte_count);
+        length--;
+        if (++pending_byte_count == 8) {
+            mix_word(pending_bytes);
+            pending_bytes = 0;
+            pending_byte_count = 0;
+        }
+    }
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        mix_word(word);
+        bytes += 8;
+        length -= 8;
+    }
+    while (length > 0) {
+        pending_bytes |= (uint64_t)*bytes++ << (8 * pending_byte_count++);
+        length--;
+    }
+}
+
+void content_hasher_t::finish(uint64_t digest[2])
+{
+    if (pending_byte_count > 0) {
+        mix_word(pending_bytes ^ ((uint64_t)pending_byte_count << 56));
+    }
+    mix_word(total_length);
+    digest[0] = final_mix(lane[0] ^ rotate_left(lane[1], 17));
+    digest[1] = final_mix(lane[1] + lane[0]);
+}
+
+bool hash_trace_file(int trace_fd, uint64_t digest[2])
+{
+    content_hasher_t hasher;
+    std::vector<uint8_t> buffer(1 << 20);
+    off_t offset = 0;
+    while (true) {
+        ssize_t count = pread(trace_fd, buffer.data(), buffer.size(), offset);
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) return false;
+        if (count == 0) break;
+        hasher.update(buffer.data(), count);
+        offset += count;
+    }
+    hasher.finish(digest);
+    return true;
+}
+
+result_cache_key_t make_result_cache_key(const uint64_t trace_digest[2], const proc_config_t& config)
+{
+    content_hasher_t hasher;
+    hasher.update_word(RESULT_CACHE_VERSION);
+    hasher.update_word(trace_digest[0]);
+    hasher.update_word(trace_digest[1]);
+    hasher.update_word(config.result_buses);
+    hasher.update_word(config.fu_type0);
+    hasher.update_word(config.fu_type1);
+    hasher.update_word(config.fu_type2);
+    hasher.update_word(config.fetch_width);
+    hasher.update_word(config.architectural_registers);
+    hasher.update_word(config.watchdog_cycles);
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        hasher.update_word(config.fu_latency[functional_unit_type_id]);
+        hasher.update_word(config.fu_pipelined[functional_unit_type_id]);
+    }
+
+    result_cache_key_t key;
+    hasher.finish(key.hash);
+    return key;
+}
+
+bool result_cache_t::open(const char* directory, uint64_t size_limit)
+{
+    if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create cache directory %s: %s\n", directory, strerror(errno));
+        return false;
+    }
+    cache_directory = directory;
+    size_limit_bytes = size_limit;
+    return true;
+}
+
+std::string result_cache_t::entry_path(const result_cache_key_t& key, const char* extension) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/%016" PRIx64 "%016" PRIx64 "%s", key.hash[0], key.hash[1], extension);
+    return cache_directory + name;
+}
+
+// Copies source_path to the already open destination, returns false on any I/O error
+static bool copy_file_contents(const char* source_path, FILE* destination)
+{
+    FILE* source = fopen(source_path, "rb");
+    if (source == NULL) return false;
+
+    char buffer[1 << 16];
+    size_t count;
+    bool copy_ok = true;
+    while ((count = fread(buffer, 1, sizeof(buffer), source)) > 0) {
+        if (fwrite(buffer, 1, count, destination) != count) {
+            copy_ok = false;
+            break;
+        }
+    }
+    copy_ok = copy_ok && !ferror(source);
+    fclose(source);
+    return copy_ok;
+}
+
+bool result_cache_t::lookup(const result_cache_key_t& key, sweep_result_t* p_result, const char* event_log_path)
+{
+    std::string stats_path = entry_path(key, ".stats");
+    FILE* stats_file = fopen(stats_path.c_str(), "r");
+    if (stats_file == NULL) return false;
+
+    unsigned version = 0;
+    int watchdog_expired = 0;
+    proc_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    bool parsed = fscanf(stats_file, "procsim-result %u\n", &version) == 1 && version == RESULT_CACHE_VERSION &&
+                  fscanf(stats_file, "cycle_count %" SCNu64 "\n", &stats.cycle_count) == 1 &&
+                  fscanf(stats_file, "retired_instruction %" SCNu64 "\n", &stats.retired_instruction) == 1 &&
+                  fscanf(stats_file, "max_disp_size %" SCNu64 "\n", &stats.max_disp_size) == 1 &&
+                  fscanf(stats_file, "avg_inst_retired %lf\n", &stats.avg_inst_retired) == 1 &&
+                  fscanf(stats_file, "avg_inst_fired %lf\n", &stats.avg_inst_fired) == 1 &&
+                  fscanf(stats_file, "avg_disp_size %lf\n", &stats.avg_disp_size) == 1 &&
+                  fscanf(stats_file, "watchdog_expired %d\n", &watchdog_expired) == 1;
+    fclose(stats_file);
+    if (!parsed) return false;
+
+    std::string log_path = entry_path(key, ".plog");
+    if (event_log_path != NULL) {
+        FILE* log_file = fopen(event_log_path, "wb");
+        if (log_file == NULL) return false;
+        bool copied = copy_file_contents(log_path.c_str(), log_file);
+        copied = (fclose(log_file) == 0) && copied;
+        if (!copied) return false;
+        utimensat(AT_FDCWD, log_path.c_str(), NULL, 0);
+    }
+    utimensat(AT_FDCWD, stats_path.c_str(), NULL, 0);
+
+    p_result->stats = stats;
+    p_result->watchdog_expired = watchdog_expired != 0;
+    return true;
+}
+
+//
+// publish_file
+//
+//  Writes contents, or a copy of copy_from_path, to a temporary file in the
+//  cache directory and renames it to final_path
+//
+bool result_cache_t::publish_file(const std::string& final_path, const std::string& contents, const char* copy_from_path)
+{
+    std::string temporary_path = cache_directory + "/.tmp.XXXXXX";
+    int temporary_fd = mkstemp(&temporary_path[0]);
+    if (temporary_fd < 0) return false;
+    fchmod(temporary_fd, 0644);
+    FILE* temporary_file = fdopen(temporary_fd, "wb");
+    if (temporary_file == NULL) {
+        close(temporary_fd);
+        unlink(temporary_path.c_str());
+        return false;
+    }
+
+    bool write_ok = copy_from_path != NULL ? copy_file_contents(copy_from_path, temporary_file)
+                                           : fwrite(contents.data(), 1, contents.size(), temporary_file) == contents.size();
+    write_ok = (fclose(temporary_file) == 0) && write_ok;
+    if (!write_ok || rename(temporary_path.c_str(), final_path.c_str()) != 0) {
+        unlink(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool result_cache_t::store(const result_cache_key_t& key, const sweep_result_t& result, const char* event_log_path)
+{
+    char contents[512];
+    snprintf(contents, sizeof(contents),
+             "procsim-result %u\ncycle_count %" PRIu64 "\nretired_instruction %" PRIu64 "\nmax_disp_size %" PRIu64 "\n"
+             "avg_inst_retired %a\navg_inst_fired %a\navg_disp_size %a\nwatchdog_expired %d\n",
+             RESULT_CACHE_VERSION, result.stats.cycle_count, result.stats.retired_instruction, result.stats.max_disp_size,
+             result.stats.avg_inst_retired, result.stats.avg_inst_fired, result.stats.avg_disp_size,
+             result.watchdog_expired ? 1 : 0);
+
+    // The event log goes first, so a visible .stats entry always had its log published
+    bool stored = (event_log_path == NULL || publish_file(entry_path(key, ".plog"), "", event_log_path)) &&
+                  publish_file(entry_path(key, ".stats"), contents, NULL);
+    if (!stored) {
+        fprintf(stderr, "Failed to store result in cache directory %s\n", cache_directory.c_str());
+        return false;
+    }
+    evict_to_limit();
+    return true;
+}
+
+// Files of one cached job, grouped by key
+typedef struct _cache_entry_usage_t
+{
+    uint64_t total_bytes;
+    time_t last_used;
+    std::vector<std::string> file_paths;
+} cache_entry_usage_t;
+
+//
+// evict_to_limit
+//
+//  Removes least recently used entries until the directory is back under
+//  RESULT_CACHE_EVICT_TARGET of its limit
+//
+void result_cache_t::evict_to_limit()
+{
+    std::string lock_path = cache_directory + "/.lock";
+    int lock_fd = ::open(lock_path.c_str(), O_RDWR | O_CREAT, 0666);
+    if (lock_fd < 0) return;
+    if (flock(lock_fd, LOCK_EX) != 0) {
+        close(lock_fd);
+        return;
+    }
+
+    DIR* directory = opendir(cache_directory.c_str());
+    if (directory == NULL) {
+        close(lock_fd);
+        return;
+    }
+    std::map<std::string, cache_entry_usage_t> entries;
+    uint64_t cached_bytes = 0;
+    time_t now = time(NULL);
+    struct dirent* directory_entry;
+    while ((directory_entry = readdir(directory)) != NULL) {
+        std::string name = directory_entry->d_name;
+        std::string path = cache_directory + "/" + name;
+        struct stat file_status;
+        if (stat(path.c_str(), &file_status) != 0 || !S_ISREG(file_status.st_mode)) continue;
+        if (name[0] == '.') {
+            if (name.compare(0, 5, ".tmp.") == 0 && now - file_status.st_mtime > RESULT_CACHE_STALE_TEMP_SECONDS) {
+                unlink(path.c_str());
+            }
+            continue;
+        }
+
+        cache_entry_usage_t& usage = entries[name.substr(0, name.find('.'))];
+        usage.total_bytes += file_status.st_size;
+        usage.last_used = std::max(usage.last_used, file_status.st_mtime);
+        usage.file_paths.push_back(path);
+        cached_bytes += file_status.st_size;
+    }
+    closedir(directory);
+
+    if (cached_bytes > size_limit_bytes) {
+        std::vector<const cache_entry_usage_t*> by_age;
+        for (const auto& entry : entries) {
+            by_age.push_back(&entry.second);
+        }
+        std::sort(by_age.begin(), by_age.end(), [](const cache_entry_usage_t* a, const cache_entry_usage_t* b) {
+            return a->last_used < b->last_used;
+        });
+
+        uint64_t target_bytes = (uint64_t)(size_limit_bytes * RESULT_CACHE_EVICT_TARGET);
+        for (const cache_entry_usage_t* usage : by_age) {
+            if (cached_bytes <= target_bytes) break;
+            for (const std::string& path : usage->file_paths) {
+                unlink(path.c_str());
+            }
+            cached_bytes -= usage->total_bytes;
+        }
+    }
+
+    flock(lock_fd, LOCK_UN);
+    close(lock_fd);
+}
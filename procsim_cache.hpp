@@ -0,0 +1,95 @@
+#ifndef PROCSIM_CACHE_HPP
+#define PROCSIM_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "procsim.hpp"
+#include "procsim_sweep.hpp"
+
+// Bumped whenever a change to the simulator could change the result of an unchanged job
+#define RESULT_CACHE_VERSION 2
+
+// Size limit of a cache directory when none is given, in megabytes
+#define DEFAULT_RESULT_CACHE_MEGABYTES 512
+
+// Identity of one simulation job: trace contents, configuration and simulator version
+typedef struct _result_cache_key_t
+{
+    uint64_t hash[2];
+} result_cache_key_t;
+
+//
+// content_hasher_t
+//
+//  128-bit non-cryptographic hash over a byte stream: two independent
+//  multiply-rotate lanes over 8-byte words. Collisions are only as
+//  unlikely as for any 128-bit hash of honest inputs.
+//
+class content_hasher_t
+{
+public:
+    content_hasher_t() : pending_byte_count(0), total_length(0)
+    {
+        lane[0] = 0x6a09e667f3bcc908ULL;
+        lane[1] = 0xbb67ae8584caa73bULL;
+        pending_bytes = 0;
+    }
+
+    void update(const void* data, size_t length);
+    void update_word(uint64_t value) { update(&value, sizeof(value)); }
+    void finish(uint64_t digest[2]);
+
+private:
+    void mix_word(uint64_t word);
+
+    uint64_t lane[2];
+    uint64_t pending_bytes;
+    unsigned pending_byte_count;
+    uint64_t total_length;
+};
+
+// Hashes the whole file behind fd without moving its offset; false if it cannot be read
+bool hash_trace_file(int trace_fd, uint64_t digest[2]);
+
+// Combines a trace hash with every configuration field that affects the result
+result_cache_key_t make_result_cache_key(const uint64_t trace_digest[2], const proc_config_t& config);
+
+//
+// result_cache_t
+//
+//  On-disk results by key: <key>.stats holds the statistics and watchdog
+//  flag, <key>.plog the event log when the job was run with one. Entries
+//  are written to a temporary file and renamed into place, so concurrent
+//  runs sharing the directory only ever see complete entries. A hit
+//  refreshes the entry's modification time; once the directory grows past
+//  its size limit, the least recently used entries are removed under an
+//  exclusive flock on <directory>/.lock so that parallel evictions do not
+//  interleave.
+//
+class result_cache_t
+{
+public:
+    result_cache_t() : size_limit_bytes(0) {}
+
+    // Uses directory, creating it if needed
+    bool open(const char* directory, uint64_t size_limit);
+
+    // Fills p_result and, if event_log_path is not NULL, copies the cached event log there;
+    // false if the entry, or its event log when one is asked for, is not cached
+    bool lookup(const result_cache_key_t& key, sweep_result_t* p_result, const char* event_log_path);
+
+    // Stores a result and, if event_log_path is not NULL, a copy of that event log
+    bool store(const result_cache_key_t& key, const sweep_result_t& result, const char* event_log_path);
+
+private:
+    std::string entry_path(const result_cache_key_t& key, const char* extension) const;
+    bool publish_file(const std::string& final_path, const std::string& contents, const char* copy_from_path);
+    void evict_to_limit();
+
+    std::string cache_directory;
+    uint64_t size_limit_bytes;
+};
+
+#endif /* PROCSIM_CACHE_HPP */
@@ -0,0 +1,427 @@
+#include "procsim.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <vector>
+
+//
+// Checkpoint layout (host byte order): the 8-byte magic, the format
+// version, the configuration it was taken under, the trace position, then
+// every piece of pipeline state in the order written by save_checkpoint
+//
+#define CHECKPOINT_MAGIC "PSIMCKP"
+#define CHECKPOINT_VERSION 3
+
+//
+// checkpoint_writer_t / checkpoint_reader_t
+//
+//  Field-at-a-time binary I/O that remembers the first failure, so callers
+//  check once at the end
+//
+class checkpoint_writer_t
+{
+public:
+    explicit checkpoint_writer_t(FILE* file) : checkpoint_file(file), write_ok(true) {}
+
+    template <typename value_t> void value(const value_t& field)
+    {
+        write_ok = write_ok && fwrite(&field, sizeof(field), 1, checkpoint_file) == 1;
+    }
+
+    template <typename value_t> void vector(const std::vector<value_t>& field)
+    {
+        value((uint64_t)field.size());
+        if (!field.empty()) write_ok = write_ok && fwrite(field.data(), sizeof(value_t), field.size(), checkpoint_file) == field.size();
+    }
+
+    bool ok() const { return write_ok; }
+
+private:
+    FILE* checkpoint_file;
+    bool write_ok;
+};
+
+class checkpoint_reader_t
+{
+public:
+    explicit checkpoint_reader_t(FILE* file) : checkpoint_file(file), read_ok(true), file_size(0)
+    {
+        struct stat file_status;
+        if (fstat(fileno(file), &file_status) == 0) file_size = (uint64_t)file_status.st_size;
+    }
+
+    template <typename value_t> void value(value_t& field)
+    {
+        read_ok = read_ok && fread(&field, sizeof(field), 1, checkpoint_file) == 1;
+    }
+
+    template <typename value_t> void vector(std::vector<value_t>& field)
+    {
+        uint64_t element_count = 0;
+        value(element_count);
+        // A count the rest of the file cannot hold is corrupt; refuse it before allocating
+        read_ok = read_ok && can_hold(element_count, sizeof(value_t));
+        if (!read_ok) return;
+        field.resize(element_count);
+        if (element_count > 0) read_ok = fread(field.data(), sizeof(value_t), element_count, checkpoint_file) == element_count;
+    }
+
+    // True if the unread part of the file has room for element_count elements of element_size bytes
+    bool can_hold(uint64_t element_count, size_t element_size) const
+    {
+        long position = ftell(checkpoint_file);
+        if (position < 0 || (uint64_t)position > file_size) return false;
+        return element_count <= (file_size - (uint64_t)position) / element_size;
+    }
+
+    bool ok() const { return read_ok; }
+
+private:
+    FILE* checkpoint_file;
+    bool read_ok;
+    uint64_t file_size;
+};
+
+// Every proc_inst_t field the pipeline reads (src_ready and src_ready_cycle are never used)
+template <typename stream_t, typename instruction_t>
+static void transfer_instruction(stream_t& stream, instruction_t& instruction)
+{
+    stream.value(instruction.instruction_address);
+    stream.value(instruction.op_code);
+    stream.value(instruction.src_reg[0]);
+    stream.value(instruction.src_reg[1]);
+    stream.value(instruction.dest_reg);
+    stream.value(instruction.tag);
+    stream.value(instruction.src_tag[0]);
+    stream.value(instruction.src_tag[1]);
+    stream.value(instruction.fire_cycle);
+    stream.value(instruction.complete_cycle);
+    stream.value(instruction.fetch_cycle);
+    stream.value(instruction.dispatch_cycle);
+    stream.value(instruction.schedule_cycle);
+    stream.value(instruction.execute_cycle);
+    stream.value(instruction.state_update_cycle);
+    stream.value(instruction.fired);
+    stream.value(instruction.completed);
+}
+
+// Queued instructions have only been fetched or dispatched; fetch zeroed the rest
+static void write_queued_instruction(checkpoint_writer_t& writer, const proc_inst_t& instruction)
+{
+    writer.value(instruction.instruction_address);
+    writer.value(instruction.op_code);
+    writer.value(instruction.src_reg[0]);
+    writer.value(instruction.src_reg[1]);
+    writer.value(instruction.dest_reg);
+    writer.value(instruction.tag);
+    writer.value(instruction.fetch_cycle);
+    writer.value(instruction.dispatch_cycle);
+}
+
+static void read_queued_instruction(checkpoint_reader_t& reader, proc_inst_t& instruction)
+{
+    memset(&instruction, 0, sizeof(proc_inst_t));
+    reader.value(instruction.instruction_address);
+    reader.value(instruction.op_code);
+    reader.value(instruction.src_reg[0]);
+    reader.value(instruction.src_reg[1]);
+    reader.value(instruction.dest_reg);
+    reader.value(instruction.tag);
+    reader.value(instruction.fetch_cycle);
+    reader.value(instruction.dispatch_cycle);
+}
+
+static void write_queue(checkpoint_writer_t& writer, const ring_buffer_t<proc_inst_t>& queue)
+{
+    writer.value((uint64_t)queue.size());
+    for (size_t position = 0; position < queue.size(); position++) {
+        write_queued_instruction(writer, queue[position]);
+    }
+}
+
+static void read_queue(checkpoint_reader_t& reader, ring_buffer_t<proc_inst_t>& queue)
+{
+    uint64_t element_count = 0;
+    reader.value(element_count);
+    queue.clear();
+    for (uint64_t position = 0; position < element_count && reader.ok(); position++) {
+        read_queued_instruction(reader, queue.push_back());
+    }
+}
+
+bool proc_sim_t::save_checkpoint(FILE* checkpoint_file) {
+    uint64_t trace_position = 0;
+    if (!trace_source->tell(&trace_position)) {
+        fprintf(stderr, "Trace source cannot be checkpointed (stdin pipes are not seekable)\n");
+        return false;
+    }
+
+    checkpoint_writer_t writer(checkpoint_file);
+    char magic[8];
+    memset(magic, 0, sizeof(magic));
+    memcpy(magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    writer.value(magic);
+    writer.value((uint32_t)CHECKPOINT_VERSION);
+
+    writer.value(number_of_result_buses);
+    writer.value(functional_unit_type0_total);
+    writer.value(functional_unit_type1_total);
+    writer.value(functional_unit_type2_total);
+    writer.value(instructions_per_cycle_fetch);
+    writer.value(architectural_register_count);
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        writer.value(functional_unit_latency[functional_unit_type_id]);
+        writer.value((uint64_t)functional_unit_pipelined[functional_unit_type_id]);
+    }
+    writer.value(trace_position);
+
+    writer.value(current_clock_cycle);
+    writer.value(next_instruction_tag);
+    writer.value(trace_fetch_done);
+    writer.value(simulation_finished);
+    writer.value(last_retirement_cycle);
+    writer.value(watchdog_tripped);
+    write_queue(writer, fetched_instruction_buffer);
+    write_queue(writer, dispatch_instruction_queue);
+    writer.value(deferred_instruction_count);
+    writer.value(fetched_deferred_count);
+    writer.value(deferred_trace_position);
+
+    writer.value(station_window_mask);
+    writer.vector(station_src_tag);
+    writer.vector(station_consumer_link);
+    writer.vector(station_completion_link);
+    writer.vector(station_fu_index);
+    writer.vector(station_fu_type);
+    for (proc_inst_t& instruction : station_instruction) {
+        transfer_instruction(writer, instruction);
+    }
+    writer.vector(station_occupied_bitmap.words());
+    writer.value(reservation_station_size);
+    writer.value(reservation_station_oldest_tag);
+    writer.value(reservation_station_newest_tag);
+    writer.value(operand_wait_count);
+
+    writer.vector(completion_wheel_head);
+    writer.value(executing_instruction_count);
+    writer.vector(result_bus_waiting_tags);
+    writer.vector(broadcast_instruction_tags);
+    writer.vector(retiring_instruction_tags);
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        writer.vector(functional_unit_free_bitmap[functional_unit_type_id]);
+        writer.value(functional_unit_free_count[functional_unit_type_id]);
+        writer.vector(ready_instruction_bitmap[functional_unit_type_id].words());
+        writer.value(ready_instruction_count[functional_unit_type_id]);
+    }
+    writer.vector(register_producer_tag_mapping);
+
+    writer.value(total_instruction_count);
+    writer.value(total_fired_instruction_count);
+    writer.value(accumulated_dispatch_queue_size);
+    writer.value(dispatch_queue_sample_count);
+    writer.value(max_dispatch_queue_size);
+
+    return writer.ok() && fflush(checkpoint_file) == 0;
+}
+
+static bool is_power_of_two(uint64_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+//
+// restored_state_consistent
+//
+//  Checks every restored length the cycle loop indexes by against the
+//  configuration and the window size, every queue and counter against its
+//  capacity, and the tag order of the linked lists and queues, so a damaged
+//  file is refused instead of read out of bounds or looped over forever
+//
+bool proc_sim_t::restored_state_consistent() const {
+    uint64_t window_size = station_window_mask + 1;
+    if (station_src_tag.size() != window_size * 2 || station_consumer_link.size() != window_size * 3 ||
+        station_completion_link.size() != window_size || station_fu_index.size() != window_size ||
+        station_fu_type.size() != window_size || station_instruction.size() != window_size ||
+        !is_power_of_two(station_occupied_bitmap.words().size())) {
+        return false;
+    }
+    if (reservation_station_size > reservation_station_max_capacity ||
+        (reservation_station_size > 0 && reservation_station_newest_tag - reservation_station_oldest_tag > station_window_mask)) {
+        return false;
+    }
+
+    if (completion_wheel_head.size() != completion_wheel_mask + 1 ||
+        executing_instruction_count > reservation_station_max_capacity ||
+        result_bus_waiting_tags.size() > reservation_station_max_capacity ||
+        broadcast_instruction_tags.size() > std::min(number_of_result_buses, reservation_station_max_capacity) ||
+        retiring_instruction_tags.size() > std::min(number_of_result_buses, reservation_station_max_capacity)) {
+        return false;
+    }
+
+    const uint64_t functional_unit_totals[3] = { functional_unit_type0_total, functional_unit_type1_total, functional_unit_type2_total };
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        if (functional_unit_free_bitmap[functional_unit_type_id].size() != (functional_unit_totals[functional_unit_type_id] + 63) / 64 ||
+            functional_unit_free_count[functional_unit_type_id] > functional_unit_totals[functional_unit_type_id] ||
+            !is_power_of_two(ready_instruction_bitmap[functional_unit_type_id].words().size()) ||
+            ready_instruction_count[functional_unit_type_id] > reservation_station_max_capacity) {
+            return false;
+        }
+    }
+
+    // Slot FU types address the ready bitmaps directly; type -1 never fires
+    for (uint64_t slot = 0; slot < window_size; slot++) {
+        if (station_fu_type[slot] < -1 || station_fu_type[slot] > 2) return false;
+    }
+
+    // Wheel buckets hold every executing instruction in rising tag order, each on a unit it can release
+    uint64_t completing_count = 0;
+    for (uint64_t bucket_head : completion_wheel_head) {
+        uint64_t previous_tag = 0;
+        for (uint64_t tag = bucket_head; tag != 0; tag = station_completion_link[station_slot(tag)]) {
+            if (tag <= previous_tag || ++completing_count > executing_instruction_count) return false;
+            int32_t functional_unit_type_id = station_fu_type[station_slot(tag)];
+            int32_t fu_index = station_fu_index[station_slot(tag)];
+            if (functional_unit_type_id < 0 || fu_index < 0 || (uint64_t)fu_index >= functional_unit_totals[functional_unit_type_id]) {
+                return false;
+            }
+            previous_tag = tag;
+        }
+    }
+    if (completing_count != executing_instruction_count) return false;
+
+    // Consumer lists run from the newest link down, each consumer waiting on at most two producers
+    uint64_t consumer_budget = reservation_station_size * 2;
+    bool consumers_consistent = true;
+    if (reservation_station_size > 0) {
+        station_occupied_bitmap.for_each_set(reservation_station_oldest_tag, reservation_station_newest_tag, [&](uint64_t producer_tag) {
+            uint64_t previous_link = (reservation_station_newest_tag + 1) << 1;
+            for (uint64_t consumer_link = station_consumer_link[station_slot(producer_tag) * 3]; consumer_link != 0;
+                 consumer_link = station_consumer_link[station_slot(consumer_link >> 1) * 3 + 1 + (consumer_link & 1)]) {
+                if ((consumer_link >> 1) <= producer_tag || consumer_link >= previous_link || consumer_budget == 0) {
+                    consumers_consistent = false;
+                    return false;
+                }
+                consumer_budget--;
+                previous_link = consumer_link;
+            }
+            return true;
+        });
+    }
+    if (!consumers_consistent) return false;
+
+    // Tags run consecutively from the newest scheduled one through the dispatch queue to next_instruction_tag
+    if (next_instruction_tag - reservation_station_newest_tag - 1 != dispatch_queue_size()) {
+        return false;
+    }
+    for (size_t queue_index = 0; queue_index < dispatch_instruction_queue.size(); queue_index++) {
+        if (dispatch_instruction_queue[queue_index].tag != reservation_station_newest_tag + 1 + queue_index) return false;
+    }
+
+    return register_producer_tag_mapping.size() == architectural_register_count &&
+           fetched_instruction_buffer.size() <= instructions_per_cycle_fetch &&
+           dispatch_instruction_queue.size() <= DISPATCH_QUEUE_RESIDENT_LIMIT;
+}
+
+bool proc_sim_t::restore_checkpoint(FILE* checkpoint_file) {
+    checkpoint_reader_t reader(checkpoint_file);
+    char magic[8];
+    uint32_t version = 0;
+    reader.value(magic);
+    reader.value(version);
+    if (!reader.ok() || memcmp(magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 || version != CHECKPOINT_VERSION) {
+        fprintf(stderr, "Not a checkpoint file\n");
+        return false;
+    }
+
+    uint64_t saved_config[12];
+    for (int config_index = 0; config_index < 12; config_index++) reader.value(saved_config[config_index]);
+    bool same_latencies = true;
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        same_latencies = same_latencies && saved_config[6 + functional_unit_type_id * 2] == functional_unit_latency[functional_unit_type_id] &&
+                         saved_config[7 + functional_unit_type_id * 2] == (uint64_t)functional_unit_pipelined[functional_unit_type_id];
+    }
+    if (!reader.ok() || !same_latencies ||
+        saved_config[0] != number_of_result_buses || saved_config[1] != functional_unit_type0_total ||
+        saved_config[2] != functional_unit_type1_total || saved_config[3] != functional_unit_type2_total ||
+        saved_config[4] != instructions_per_cycle_fetch || saved_config[5] != architectural_register_count) {
+        fprintf(stderr, "Checkpoint was taken under a different configuration\n");
+        return false;
+    }
+
+    uint64_t trace_position = 0;
+    reader.value(trace_position);
+
+    reader.value(current_clock_cycle);
+    reader.value(next_instruction_tag);
+    reader.value(trace_fetch_done);
+    reader.value(simulation_finished);
+    reader.value(last_retirement_cycle);
+    reader.value(watchdog_tripped);
+    read_queue(reader, fetched_instruction_buffer);
+    read_queue(reader, dispatch_instruction_queue);
+    reader.value(deferred_instruction_count);
+    reader.value(fetched_deferred_count);
+    reader.value(deferred_trace_position);
+
+    reader.value(station_window_mask);
+    reader.vector(station_src_tag);
+    reader.vector(station_consumer_link);
+    reader.vector(station_completion_link);
+    reader.vector(station_fu_index);
+    reader.vector(station_fu_type);
+    uint64_t window_size = station_window_mask + 1;
+    if (!reader.ok() || window_size < 64 || (window_size & station_window_mask) != 0 ||
+        !reader.can_hold(window_size, sizeof(uint64_t))) {
+        fprintf(stderr, "Checkpoint file is corrupt\n");
+        return false;
+    }
+    station_instruction.assign(window_size, proc_inst_t());
+    for (proc_inst_t& instruction : station_instruction) {
+        transfer_instruction(reader, instruction);
+    }
+    std::vector<uint64_t> bitmap_words;
+    reader.vector(bitmap_words);
+    station_occupied_bitmap.assign_words(bitmap_words);
+    reader.value(reservation_station_size);
+    reader.value(reservation_station_oldest_tag);
+    reader.value(reservation_station_newest_tag);
+    reader.value(operand_wait_count);
+
+    reader.vector(completion_wheel_head);
+    reader.value(executing_instruction_count);
+    reader.vector(result_bus_waiting_tags);
+    reader.vector(broadcast_instruction_tags);
+    reader.vector(retiring_instruction_tags);
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        reader.vector(functional_unit_free_bitmap[functional_unit_type_id]);
+        reader.value(functional_unit_free_count[functional_unit_type_id]);
+        reader.vector(bitmap_words);
+        ready_instruction_bitmap[functional_unit_type_id].assign_words(bitmap_words);
+        reader.value(ready_instruction_count[functional_unit_type_id]);
+    }
+    reader.vector(register_producer_tag_mapping);
+
+    reader.value(total_instruction_count);
+    reader.value(total_fired_instruction_count);
+    reader.value(accumulated_dispatch_queue_size);
+    reader.value(dispatch_queue_sample_count);
+    reader.value(max_dispatch_queue_size);
+
+    if (!reader.ok()) {
+        fprintf(stderr, "Checkpoint file is truncated\n");
+        return false;
+    }
+    if (!restored_state_consistent()) {
+        fprintf(stderr, "Checkpoint file is corrupt\n");
+        return false;
+    }
+    if (!trace_source->seek(trace_position)) {
+        fprintf(stderr, "Trace source cannot seek to the checkpoint position\n");
+        return false;
+    }
+    // Attached observers only see what happens after the restore
+    stall_sampled_fired_count = total_fired_instruction_count;
+    next_logged_tag = first_unretired_tag();
+    return true;
+}
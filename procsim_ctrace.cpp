@@ -0,0 +1,328 @@
+#include "procsim_ctrace.hpp"
+#include <algorithm>
+#include <cstring>
+#include <sys/types.h>
+
+// Bits of a source position holding the record index within its block
+#define COMPRESSED_POSITION_INDEX_BITS 17
+
+// Largest payload a block of record_count records can need: every field at full width
+#define COMPRESSED_MAX_RECORD_BITS (2 + 32 + 16 + 3 * 16)
+
+// Bits needed to hold every value in [0, range]
+static uint8_t bits_for_range(uint32_t range)
+{
+    uint8_t bit_count = 0;
+    while (bit_count < 32 && (range >> bit_count) != 0) bit_count++;
+    return bit_count;
+}
+
+static uint32_t zigzag_encode(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t zigzag_decode(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+//
+// bit_packer_t / bit_unpacker_t
+//
+//  Little-endian bit streams over a byte vector; fields are at most 32 bits
+//
+class bit_packer_t
+{
+public:
+    explicit bit_packer_t(std::vector<uint8_t>& output) : output_bytes(output), pending_bits(0), pending_bit_count(0) {}
+
+    void put(uint32_t value, unsigned bit_count)
+    {
+        pending_bits |= (uint64_t)value << pending_bit_count;
+        pending_bit_count += bit_count;
+        while (pending_bit_count >= 8) {
+            output_bytes.push_back((uint8_t)pending_bits);
+            pending_bits >>= 8;
+            pending_bit_count -= 8;
+        }
+    }
+
+    void flush()
+    {
+        if (pending_bit_count > 0) output_bytes.push_back((uint8_t)pending_bits);
+        pending_bits = 0;
+        pending_bit_count = 0;
+    }
+
+private:
+    std::vector<uint8_t>& output_bytes;
+    uint64_t pending_bits;
+    unsigned pending_bit_count;
+};
+
+class bit_unpacker_t
+{
+public:
+    bit_unpacker_t(const uint8_t* input, size_t input_length)
+        : input_bytes(input), input_end(input + input_length), pending_bits(0), pending_bit_count(0) {}
+
+    uint32_t take(unsigned bit_count)
+    {
+        // Past the end reads zeros; the caller checks overrun() once per block
+        while (pending_bit_count < bit_count) {
+            uint64_t next_byte = input_bytes < input_end ? *input_bytes : 0;
+            input_bytes++;
+            pending_bits |= next_byte << pending_bit_count;
+            pending_bit_count += 8;
+        }
+        uint32_t value = (uint32_t)(pending_bits & ((1ULL << bit_count) - 1));
+        pending_bits >>= bit_count;
+        pending_bit_count -= bit_count;
+        return value;
+    }
+
+    bool overrun() const { return input_bytes > input_end; }
+
+private:
+    const uint8_t* input_bytes;
+    const uint8_t* input_end;
+    uint64_t pending_bits;
+    unsigned pending_bit_count;
+};
+
+bool compressed_trace_writer_t::open(FILE* compressed_file)
+{
+    trace_file = compressed_file;
+    block_records.clear();
+    block_records.reserve(COMPRESSED_TRACE_BLOCK_RECORDS);
+
+    compressed_trace_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPRESSED_TRACE_MAGIC, sizeof(COMPRESSED_TRACE_MAGIC));
+    header.version = COMPRESSED_TRACE_VERSION;
+    header.block_records = COMPRESSED_TRACE_BLOCK_RECORDS;
+    write_ok = fwrite(&header, sizeof(header), 1, trace_file) == 1;
+    return write_ok;
+}
+
+void compressed_trace_writer_t::write_block()
+{
+    if (block_records.empty()) return;
+
+    // Field widths cover the value ranges of this block only
+    int32_t op_code_min = INT16_MAX, op_code_max = INT16_MIN;
+    int32_t register_min = INT16_MAX, register_max = INT16_MIN;
+    for (const trace_record_t& record : block_records) {
+        op_code_min = std::min(op_code_min, (int32_t)record.op_code);
+        op_code_max = std::max(op_code_max, (int32_t)record.op_code);
+        register_min = std::min({ register_min, (int32_t)record.dest_reg, (int32_t)record.src_reg[0], (int32_t)record.src_reg[1] });
+        register_max = std::max({ register_max, (int32_t)record.dest_reg, (int32_t)record.src_reg[0], (int32_t)record.src_reg[1] });
+    }
+
+    compressed_block_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.record_count = block_records.size();
+    header.first_address = block_records[0].instruction_address;
+    header.op_code_base = op_code_min;
+    header.register_base = register_min;
+    header.op_code_bits = bits_for_range(op_code_max - op_code_min);
+    header.register_bits = bits_for_range(register_max - register_min);
+
+    block_payload.clear();
+    bit_packer_t packer(block_payload);
+    uint32_t previous_address = header.first_address - 4;
+    for (const trace_record_t& record : block_records) {
+        uint32_t expected_address = previous_address + 4;
+        if (record.instruction_address == expected_address) {
+            packer.put(1, 1);
+        } else {
+            int64_t delta = (int64_t)(int32_t)(record.instruction_address - expected_address);
+            if (delta >= INT16_MIN && delta <= INT16_MAX) {
+                packer.put(2, 2);
+                packer.put(zigzag_encode((int32_t)delta), 16);
+            } else {
+                packer.put(0, 2);
+                packer.put(record.instruction_address, 32);
+            }
+        }
+        previous_address = record.instruction_address;
+
+        packer.put(record.op_code - header.op_code_base, header.op_code_bits);
+        packer.put(record.dest_reg - header.register_base, header.register_bits);
+        packer.put(record.src_reg[0] - header.register_base, header.register_bits);
+        packer.put(record.src_reg[1] - header.register_base, header.register_bits);
+    }
+    packer.flush();
+    header.payload_bytes = block_payload.size();
+
+    write_ok = write_ok && fwrite(&header, sizeof(header), 1, trace_file) == 1 &&
+               fwrite(block_payload.data(), 1, block_payload.size(), trace_file) == block_payload.size();
+    block_records.clear();
+}
+
+bool compressed_trace_writer_t::finish()
+{
+    write_block();
+    write_ok = write_ok && fflush(trace_file) == 0;
+    return write_ok;
+}
+
+bool compressed_trace_source::open(const char* path)
+{
+    close();
+
+    trace_file = fopen(path, "rb");
+    if (trace_file == NULL) {
+        fprintf(stderr, "Failed to open %s for reading\n", path);
+        return false;
+    }
+    setvbuf(trace_file, NULL, _IOFBF, 1 << 20);
+
+    compressed_trace_header_t header;
+    if (fread(&header, sizeof(header), 1, trace_file) != 1 ||
+        memcmp(header.magic, COMPRESSED_TRACE_MAGIC, sizeof(COMPRESSED_TRACE_MAGIC)) != 0 ||
+        header.version != COMPRESSED_TRACE_VERSION ||
+        header.block_records == 0 || header.block_records >= (1U << COMPRESSED_POSITION_INDEX_BITS)) {
+        fprintf(stderr, "%s is not a valid compressed trace\n", path);
+        close();
+        return false;
+    }
+
+    block_offset = sizeof(header);
+    corrupt = false;
+    decoded_records.clear();
+    decoded_records.reserve(header.block_records);
+    next_record_index = 0;
+    return true;
+}
+
+void compressed_trace_source::close()
+{
+    if (trace_file != NULL) {
+        fclose(trace_file);
+    }
+    trace_file = NULL;
+    decoded_records.clear();
+    next_record_index = 0;
+}
+
+bool compressed_trace_source::load_block()
+{
+    decoded_records.clear();
+    next_record_index = 0;
+    if (trace_file == NULL) return false;
+
+    off_t offset = ftello(trace_file);
+    if (offset < 0) return false;
+    block_offset = (uint64_t)offset;
+
+    compressed_block_header_t header;
+    if (fread(&header, sizeof(header), 1, trace_file) != 1) return false;
+
+    uint64_t payload_limit = ((uint64_t)header.record_count * COMPRESSED_MAX_RECORD_BITS + 7) / 8;
+    if (header.record_count == 0 || header.record_count >= (1U << COMPRESSED_POSITION_INDEX_BITS) ||
+        header.payload_bytes > payload_limit || header.op_code_bits > 16 || header.register_bits > 16) {
+        fprintf(stderr, "Compressed trace block at offset %llu is corrupt\n", (unsigned long long)block_offset);
+        corrupt = true;
+        return false;
+    }
+    block_payload.resize(header.payload_bytes);
+    if (fread(block_payload.data(), 1, header.payload_bytes, trace_file) != header.payload_bytes) {
+        fprintf(stderr, "Compressed trace block at offset %llu is truncated\n", (unsigned long long)block_offset);
+        corrupt = true;
+        return false;
+    }
+
+    bit_unpacker_t unpacker(block_payload.data(), block_payload.size());
+    decoded_records.resize(header.record_count);
+    uint32_t previous_address = header.first_address - 4;
+    for (trace_record_t& record : decoded_records) {
+        uint32_t expected_address = previous_address + 4;
+        if (unpacker.take(1) != 0) {
+            record.instruction_address = expected_address;
+        } else if (unpacker.take(1) != 0) {
+            record.instruction_address = expected_address + (uint32_t)zigzag_decode(unpacker.take(16));
+        } else {
+            record.instruction_address = unpacker.take(32);
+        }
+        previous_address = record.instruction_address;
+
+        record.op_code = (int16_t)(header.op_code_base + (int32_t)unpacker.take(header.op_code_bits));
+        record.dest_reg = (int16_t)(header.register_base + (int32_t)unpacker.take(header.register_bits));
+        record.src_reg[0] = (int16_t)(header.register_base + (int32_t)unpacker.take(header.register_bits));
+        record.src_reg[1] = (int16_t)(header.register_base + (int32_t)unpacker.take(header.register_bits));
+    }
+    if (unpacker.overrun()) {
+        fprintf(stderr, "Compressed trace block at offset %llu is corrupt\n", (unsigned long long)block_offset);
+        decoded_records.clear();
+        corrupt = true;
+        return false;
+    }
+    return true;
+}
+
+bool compressed_trace_source::tell(uint64_t* p_position)
+{
+    if (trace_file == NULL) return false;
+    *p_position = (block_offset << COMPRESSED_POSITION_INDEX_BITS) | next_record_index;
+    return true;
+}
+
+bool compressed_trace_source::seek(uint64_t position)
+{
+    if (trace_file == NULL) return false;
+    uint64_t target_block_offset = position >> COMPRESSED_POSITION_INDEX_BITS;
+    size_t target_record_index = position & ((1ULL << COMPRESSED_POSITION_INDEX_BITS) - 1);
+
+    // Moving within the decoded block needs no I/O
+    if (target_block_offset != block_offset || decoded_records.empty()) {
+        if (fseeko(trace_file, (off_t)target_block_offset, SEEK_SET) != 0) return false;
+        if (!load_block()) {
+            // Only the end of the trace may have no block to load
+            block_offset = target_block_offset;
+            return target_record_index == 0;
+        }
+    }
+    if (target_record_index > decoded_records.size()) return false;
+    next_record_index = target_record_index;
+    return true;
+}
+
+bool is_compressed_trace_file(const char* path)
+{
+    FILE* trace_file = fopen(path, "rb");
+    if (trace_file == NULL) return false;
+
+    compressed_trace_header_t header;
+    bool has_header = fread(&header, sizeof(header), 1, trace_file) == 1 &&
+                      memcmp(header.magic, COMPRESSED_TRACE_MAGIC, sizeof(COMPRESSED_TRACE_MAGIC)) == 0;
+    fclose(trace_file);
+    return has_header;
+}
+
+bool convert_text_trace_to_compressed(FILE* text_file, FILE* compressed_file)
+{
+    compressed_trace_writer_t writer;
+    if (!writer.open(compressed_file)) return false;
+
+    trace_record_t record;
+    bool malformed;
+    while (read_text_trace_record(text_file, &record, &malformed)) {
+        if (!writer.append(record)) return false;
+    }
+    if (malformed) return false;
+    return writer.finish();
+}
+
+bool load_compressed_trace(const char* path, std::vector<trace_record_t>& trace)
+{
+    compressed_trace_source source;
+    if (!source.open(path)) return false;
+
+    trace_record_t record;
+    while (source.read_record(&record)) {
+        trace.push_back(record);
+    }
+    return !source.failed();
+}
@@ -0,0 +1,144 @@
+#ifndef PROCSIM_CTRACE_HPP
+#define PROCSIM_CTRACE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "procsim.hpp"
+#include "procsim_trace.hpp"
+
+//
+// Compressed trace layout (host byte order): a compressed_trace_header_t
+// followed by blocks of up to block_records records, each a
+// compressed_block_header_t and a bit-packed payload. Blocks decode on
+// their own, so a reader holds one block in memory at a time.
+//
+// Payload fields per record, least significant bit first:
+//   1 bit   address is the previous address + 4 (the first record of a
+//           block follows first_address - 4)
+//   1 bit   (if not) near: 16-bit zigzag delta from previous address + 4,
+//           otherwise the 32-bit address itself
+//   op_code_bits          op_code - op_code_base
+//   3 x register_bits     dest_reg, src_reg[0], src_reg[1] - register_base
+//
+#define COMPRESSED_TRACE_MAGIC "PSIMCTR"
+#define COMPRESSED_TRACE_VERSION 1
+#define COMPRESSED_TRACE_BLOCK_RECORDS 65536
+
+typedef struct _compressed_trace_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t block_records;
+} compressed_trace_header_t;
+
+typedef struct _compressed_block_header_t
+{
+    uint32_t record_count;
+    uint32_t payload_bytes;
+    uint32_t first_address;
+    int16_t op_code_base;
+    int16_t register_base;
+    uint8_t op_code_bits;
+    uint8_t register_bits;
+    uint8_t reserved[2];
+} compressed_block_header_t;
+
+// Returns true if the file at path starts with a compressed trace header
+bool is_compressed_trace_file(const char* path);
+
+// Streams a text trace into the compressed format, returns false on error
+bool convert_text_trace_to_compressed(FILE* text_file, FILE* compressed_file);
+
+// Decodes an entire compressed trace into memory, for modes that need random access
+bool load_compressed_trace(const char* path, std::vector<trace_record_t>& trace);
+
+//
+// compressed_trace_writer_t
+//
+//  Buffers one block of records and writes it packed once full; finish()
+//  writes the last partial block. Writes strictly sequentially, so the
+//  output may be a pipe.
+//
+class compressed_trace_writer_t
+{
+public:
+    compressed_trace_writer_t() : trace_file(NULL), write_ok(false) {}
+
+    bool open(FILE* compressed_file);
+    bool append(const trace_record_t& record)
+    {
+        block_records.push_back(record);
+        if (block_records.size() == COMPRESSED_TRACE_BLOCK_RECORDS) write_block();
+        return write_ok;
+    }
+    bool finish();
+
+private:
+    compressed_trace_writer_t(const compressed_trace_writer_t&);
+    compressed_trace_writer_t& operator=(const compressed_trace_writer_t&);
+
+    void write_block();
+
+    FILE* trace_file;
+    bool write_ok;
+    std::vector<trace_record_t> block_records;
+    std::vector<uint8_t> block_payload;
+};
+
+//
+// compressed_trace_source
+//
+//  Streams a compressed trace file block by block. Positions pack the file
+//  offset of a block with the record index inside it, so tell/seek work
+//  for checkpoints and the deferred dispatch queue.
+//
+class compressed_trace_source : public instruction_source
+{
+public:
+    compressed_trace_source() : trace_file(NULL), block_offset(0), next_record_index(0), corrupt(false) {}
+    ~compressed_trace_source() { close(); }
+
+    bool open(const char* path);
+    void close();
+
+    // Next record in trace order, returns false at end of trace or on a corrupt block
+    bool read_record(trace_record_t* p_record)
+    {
+        while (next_record_index == decoded_records.size()) {
+            if (!load_block()) return false;
+        }
+        *p_record = decoded_records[next_record_index++];
+        return true;
+    }
+
+    bool read(proc_inst_t* p_inst)
+    {
+        trace_record_t record;
+        if (!read_record(&record)) return false;
+        trace_record_to_instruction(record, p_inst);
+        return true;
+    }
+
+    bool tell(uint64_t* p_position);
+    bool seek(uint64_t position);
+
+    // True once a read stopped at a corrupt or truncated block rather than the end of the trace
+    bool failed() const { return corrupt; }
+
+private:
+    compressed_trace_source(const compressed_trace_source&);
+    compressed_trace_source& operator=(const compressed_trace_source&);
+
+    bool load_block();
+
+    FILE* trace_file;
+    uint64_t block_offset;   // File offset of the decoded block, or of the next block before the first load
+    std::vector<uint8_t> block_payload;
+    std::vector<trace_record_t> decoded_records;
+    size_t next_record_index;
+    bool corrupt;
+};
+
+#endif /* PROCSIM_CTRACE_HPP */
@@ -1,12 +1,51 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <cstdio>
 #include <cinttypes>
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
 #include <unistd.h>
+#include <vector>
 #include "procsim.hpp"
+#include "procsim_cache.hpp"
+#include "procsim_ctrace.hpp"
+#include "procsim_interval.hpp"
+#include "procsim_log.hpp"
+#include "procsim_perf.hpp"
+#include "procsim_prefetch.hpp"
+#include "procsim_sample.hpp"
+#include "procsim_stats.hpp"
+#include "procsim_sweep.hpp"
+#include "procsim_trace.hpp"
+
+// Most worker threads -t accepts
+#define MAX_WORKER_THREADS 1024
+
+// Most sampled units -p accepts
+#define MAX_SAMPLE_COUNT (1ULL << 20)
+
+// Longest -u unit or -w warm-up accepted, so slice lengths cannot overflow
+#define MAX_SAMPLING_LENGTH (1ULL << 40)
 
 FILE* inFile = stdin;
 
+// Path given with -i, hashed to key the result cache; NULL when reading stdin
+const char* tracePath = NULL;
+
+// Binary traces given with -i are mapped and replayed without parsing
+mapped_trace_t mappedTrace;
+memory_trace_source* mappedTraceSource = NULL;
+
+// Compressed traces given with -i are decoded block by block as they are fetched
+compressed_trace_source compressedTrace;
+bool useCompressedTrace = false;
+
 void print_help_and_exit(void) {
     printf("procsim [OPTIONS]\n");
     printf("  -j k0\t\tNumber of k0 FUs\n");
@@ -14,7 +53,26 @@ void print_help_and_exit(void) {
     printf("  -l k2\t\tNumber of k2 FUs\n");   
     printf("  -f N\t\tNumber of instructions to fetch\n");
     printf("  -r R\t\tNumber of result buses\n");
-    printf("  -i traces/file.trace\n");
+    printf("  -i traces/file.trace\tText trace, or binary or compressed trace from procsim_tracecvt\n");
+    printf("  -a regs\tNumber of architectural registers, 1..%d (default %d)\n", MAX_ARCH_REGS, DEFAULT_ARCH_REGS);
+    printf("  -L l0,l1,l2\tExecution latency of each FU type, p marks a pipelined type (e.g. 1,3p,5; default 1,1,1)\n");
+    printf("  -e file\tWrite a binary pipeline event log (see procsim_logtool)\n");
+    printf("  -s file\tWrite statistics and stall attribution as JSON (- for stdout, moving the cycle count to stderr)\n");
+    printf("  -c file\tCheckpoint the full simulator state to file every -n cycles\n");
+    printf("  -n cycles\tCheckpoint interval (default 100000)\n");
+    printf("  -C file\tResume from a checkpoint taken with the same trace and configuration\n");
+    printf("  -t threads\tWorker threads for sweeps and sampling (default: all cores)\n");
+    printf("  -p samples\tEstimate cycles from this many (at least 2) sampled units instead of a full run\n");
+    printf("  -u length\tInstructions measured per sampled unit (default 10000)\n");
+    printf("  -P count\tSimulate this many intervals of the trace in parallel and stitch the results\n");
+    printf("  -w length\tDetailed warm-up instructions before each unit or interval (default 2000)\n");
+    printf("  -S\t\tRead the trace on the simulation thread instead of a prefetch thread\n");
+    printf("  -D dir\t\tReuse results of identical earlier runs cached in dir (single configuration only)\n");
+    printf("  -M megabytes\tSize limit of the -D cache (default %d)\n", DEFAULT_RESULT_CACHE_MEGABYTES);
+    printf("  -H\t\tReport host cycles, instructions, cache misses and branch mispredicts per stage (single run only)\n");
+    printf("  -W cycles\tAbandon a run with an error after this many cycles without a retirement (default %d)\n", DEFAULT_WATCHDOG_CYCLES);
+    printf("\n  -r, -j, -k, -l and -f accept comma separated lists (e.g. -r 1,2,4);\n");
+    printf("  every combination is simulated from a single pass over the trace\n");
     printf("  -h\t\tThis helpful output\n");
     exit(0);
 }
@@ -33,8 +91,15 @@ bool read_instruction(proc_inst_t* p_inst)
         fprintf(stderr, "Fetch requires a valid pointer to populate\n");
         return false;
     }
+
+    if (mappedTraceSource != NULL) {
+        return mappedTraceSource->read(p_inst);
+    }
+    if (useCompressedTrace) {
+        return compressedTrace.read(p_inst);
+    }
     
-    ret = fscanf(stdin, "%x %d %d %d %d\n", &p_inst->instruction_address,
+    ret = fscanf(inFile, "%x %d %d %d %d\n", &p_inst->instruction_address,
                  &p_inst->op_code, &p_inst->dest_reg, &p_inst->src_reg[0], &p_inst->src_reg[1]); 
     if (ret != 5) {
         return false;
@@ -45,33 +110,323 @@ bool read_instruction(proc_inst_t* p_inst)
 
 void print_statistics(proc_stats_t* p_stats);
 
+//
+// parse_bounded_value
+//
+//  returns argument as a number in minimum..maximum, exits with status 1
+//  if it is not one
+//
+uint64_t parse_bounded_value(const char* option, const char* argument, uint64_t minimum, uint64_t maximum)
+{
+    char* value_end;
+    errno = 0;
+    uint64_t value = strtoull(argument, &value_end, 10);
+    if (!isdigit((unsigned char)argument[0]) || value_end == argument || *value_end != '\0' || errno != 0 || value < minimum || value > maximum) {
+        fprintf(stderr, "%s must be between %" PRIu64 " and %" PRIu64 "\n", option, minimum, maximum);
+        exit(1);
+    }
+    return value;
+}
+
+//
+// parse_value_list
+//
+//  Parses a comma separated option argument such as "1,2,4", every value
+//  in 1..maximum; exits with status 1 otherwise
+//
+std::vector<uint64_t> parse_value_list(const char* option, const char* argument, uint64_t maximum)
+{
+    std::vector<uint64_t> values;
+    const char* cursor = argument;
+    while (*cursor != '\0') {
+        const char* value_end = strchr(cursor, ',');
+        if (value_end == NULL) value_end = cursor + strlen(cursor);
+        std::string value(cursor, value_end);
+        values.push_back(parse_bounded_value(option, value.c_str(), 1, maximum));
+        cursor = (*value_end == ',') ? value_end + 1 : value_end;
+    }
+    if (values.empty()) {
+        fprintf(stderr, "Invalid value list %s\n", argument);
+        print_help_and_exit();
+    }
+    return values;
+}
+
+//
+// load_shared_trace
+//
+//  Returns the records of the -i binary trace, or decodes the compressed
+//  or text trace into storage and returns those
+//
+const trace_record_t* load_shared_trace(std::vector<trace_record_t>& storage, uint64_t* p_length)
+{
+    if (mappedTraceSource != NULL) {
+        *p_length = mappedTrace.size();
+        return mappedTrace.records();
+    }
+    trace_record_t record;
+    if (useCompressedTrace) {
+        while (compressedTrace.read_record(&record)) storage.push_back(record);
+        if (compressedTrace.failed()) exit(1);
+    } else if (!load_text_trace(inFile, storage)) {
+        exit(1);
+    }
+    *p_length = storage.size();
+    return storage.data();
+}
+
+//
+// run_sweep
+//
+//  Simulates every combination of the option value lists in parallel,
+//  decoding a text or compressed trace only once, and prints one line per
+//  configuration; returns nonzero if any tripped the watchdog
+//
+int run_sweep(const std::vector<proc_config_t>& configs, unsigned thread_count, bool prefetch_trace)
+{
+    std::vector<sweep_result_t> results;
+    if (mappedTraceSource != NULL) {
+        // Mapped records need no decoding, so each configuration replays them independently
+        run_parameter_sweep(mappedTrace.records(), mappedTrace.size(), configs, results, thread_count);
+    } else {
+        // Text and compressed traces are decoded once and streamed to every configuration
+        file_trace_source text_trace_source(inFile);
+        instruction_source* sweep_source = useCompressedTrace ? (instruction_source*)&compressedTrace : &text_trace_source;
+        std::unique_ptr<prefetching_trace_source> trace_prefetcher;
+        if (prefetch_trace && std::thread::hardware_concurrency() > 1) {
+            trace_prefetcher.reset(new prefetching_trace_source(sweep_source));
+            sweep_source = trace_prefetcher.get();
+        }
+        bool sweep_ok = run_lockstep_sweep(sweep_source, configs, results, thread_count);
+        if (trace_prefetcher) {
+            trace_prefetcher->stop();
+        }
+        if (!sweep_ok || (useCompressedTrace && compressedTrace.failed())) {
+            return 1;
+        }
+    }
+
+    // Configurations abandoned by the watchdog report it in place of a cycle count
+    int exit_status = 0;
+    printf("R\tk0\tk1\tk2\tF\tcycles\n");
+    for (size_t config_index = 0; config_index < configs.size(); config_index++) {
+        printf("%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t",
+               configs[config_index].result_buses, configs[config_index].fu_type0,
+               configs[config_index].fu_type1, configs[config_index].fu_type2,
+               configs[config_index].fetch_width);
+        if (results[config_index].watchdog_expired) {
+            printf("watchdog\n");
+            exit_status = 1;
+        } else {
+            printf("%" PRIu64 "\n", results[config_index].stats.cycle_count - 1);
+        }
+    }
+    return exit_status;
+}
+
+//
+// run_sampling
+//
+//  Estimates the cycle count of one configuration from sampled units and
+//  prints the estimate with its confidence interval
+//
+int run_sampling(const proc_config_t& config, const sampling_config_t& sampling, unsigned thread_count)
+{
+    std::vector<trace_record_t> trace;
+    uint64_t trace_length;
+    const trace_record_t* trace_records = load_shared_trace(trace, &trace_length);
+
+    sampling_result_t result;
+    if (!run_sampled_simulation(trace_records, trace_length, config, sampling, thread_count, &result)) {
+        return 1;
+    }
+
+    int confidence_percent = (int)(sampling.confidence_level * 100 + 0.5);
+    printf("Estimated cycles: %.0f (%d%% CI %.0f - %.0f)\n", result.estimated_cycles, confidence_percent,
+           result.estimated_cycles_low, result.estimated_cycles_high);
+    printf("Estimated IPC: %f (%d%% CI %f - %f)\n", result.estimated_ipc, confidence_percent,
+           result.estimated_ipc_low, result.estimated_ipc_high);
+    printf("Samples: %" PRIu64 " x %" PRIu64 " instructions after %" PRIu64 " warm-up (%.2f%% of trace in detail)\n",
+           result.sample_count, sampling.unit_length, sampling.warmup_length,
+           100.0 * (double)result.detailed_instruction_count / (double)trace_length);
+    return 0;
+}
+
+//
+// run_intervals
+//
+//  Simulates one configuration as parallel intervals and prints the
+//  stitched cycle count with its estimated error
+//
+int run_intervals(const proc_config_t& config, uint64_t interval_count, uint64_t warmup_length, unsigned thread_count)
+{
+    std::vector<trace_record_t> trace;
+    uint64_t trace_length;
+    const trace_record_t* trace_records = load_shared_trace(trace, &trace_length);
+
+    interval_result_t result;
+    if (!run_interval_simulation(trace_records, trace_length, config, interval_count, warmup_length, thread_count, &result)) {
+        return 1;
+    }
+
+    uint64_t cycles = result.stats.cycle_count - 1;
+    printf("Cycles: %" PRIu64 " (estimated error %" PRIu64 " cycles, %.4f%%)\n", cycles, result.estimated_error_cycles,
+           cycles > 0 ? 100.0 * (double)result.estimated_error_cycles / (double)cycles : 0.0);
+    printf("Avg inst retired per cycle: %f\n", result.stats.avg_inst_retired);
+    printf("Avg inst fired per cycle: %f\n", result.stats.avg_inst_fired);
+    printf("Intervals: %" PRIu64 " with %" PRIu64 " warm-up instructions each\n", result.interval_count, warmup_length);
+    return 0;
+}
+
+//
+// open_result_cache
+//
+//  Hashes the trace and derives the cache key of config; false if the
+//  trace is a pipe or cannot be read, in which case the run is not cached
+//
+bool open_result_cache(result_cache_t& result_cache, const char* cache_directory, uint64_t cache_megabytes,
+                       const proc_config_t& config, result_cache_key_t* p_key)
+{
+    int trace_fd = tracePath != NULL ? open(tracePath, O_RDONLY) : fileno(stdin);
+    struct stat trace_status;
+    bool hashable = trace_fd >= 0 && fstat(trace_fd, &trace_status) == 0 && S_ISREG(trace_status.st_mode);
+    uint64_t trace_digest[2];
+    hashable = hashable && hash_trace_file(trace_fd, trace_digest);
+    if (tracePath != NULL && trace_fd >= 0) {
+        close(trace_fd);
+    }
+    if (!hashable) {
+        fprintf(stderr, "-D needs a trace file that can be read twice; not caching this run\n");
+        return false;
+    }
+    if (!result_cache.open(cache_directory, cache_megabytes << 20)) {
+        return false;
+    }
+    *p_key = make_result_cache_key(trace_digest, config);
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     int opt;
-    uint64_t f = DEFAULT_F;
-    uint64_t k0 = DEFAULT_K0;
-    uint64_t k1 = DEFAULT_K1;
-    uint64_t k2 = DEFAULT_K2;
-    uint64_t r = DEFAULT_R;
+    std::vector<uint64_t> f(1, DEFAULT_F);
+    std::vector<uint64_t> k0(1, DEFAULT_K0);
+    std::vector<uint64_t> k1(1, DEFAULT_K1);
+    std::vector<uint64_t> k2(1, DEFAULT_K2);
+    std::vector<uint64_t> r(1, DEFAULT_R);
+    uint64_t architectural_registers = DEFAULT_ARCH_REGS;
+    uint64_t watchdog_cycles = DEFAULT_WATCHDOG_CYCLES;
+    uint64_t fu_latency[3] = { DEFAULT_FU_LATENCY, DEFAULT_FU_LATENCY, DEFAULT_FU_LATENCY };
+    bool fu_pipelined[3] = { false, false, false };
+    bool prefetch_trace = true;
+    bool host_counters = false;
+    unsigned thread_count = 0;
+    const char* event_log_path = NULL;
+    const char* stats_json_path = NULL;
+    const char* checkpoint_path = NULL;
+    const char* resume_path = NULL;
+    const char* cache_directory = NULL;
+    uint64_t cache_megabytes = DEFAULT_RESULT_CACHE_MEGABYTES;
+    uint64_t checkpoint_interval = 100000;
+    uint64_t interval_count = 0;
+    sampling_config_t sampling;
+    sampling.sample_count = 0;
+    sampling.unit_length = 10000;
+    sampling.warmup_length = 2000;
+    sampling.confidence_level = 0.95;
 
     /* Read arguments */ 
-    while(-1 != (opt = getopt(argc, argv, "r:i:j:k:l:f:h"))) {
+    while(-1 != (opt = getopt(argc, argv, "r:i:j:k:l:f:a:L:e:s:c:n:C:t:p:u:w:P:SD:M:W:Hh"))) {
         switch(opt) {
         case 'r':
-            r = atoi(optarg);
+            r = parse_value_list("-r", optarg, MAX_PIPELINE_WIDTH);
             break;
         case 'j':
-            k0 = atoi(optarg);
+            k0 = parse_value_list("-j", optarg, MAX_PIPELINE_WIDTH);
             break;
         case 'k':
-            k1 = atoi(optarg);
+            k1 = parse_value_list("-k", optarg, MAX_PIPELINE_WIDTH);
             break;
         case 'l':
-            k2 = atoi(optarg);
+            k2 = parse_value_list("-l", optarg, MAX_PIPELINE_WIDTH);
             break;
         case 'f':
-            f = atoi(optarg);
+            f = parse_value_list("-f", optarg, MAX_PIPELINE_WIDTH);
+            break;
+        case 'a':
+            architectural_registers = parse_bounded_value("-a", optarg, 1, MAX_ARCH_REGS);
+            break;
+        case 'L':
+            if (!parse_fu_latency_list(optarg, fu_latency, fu_pipelined)) {
+                fprintf(stderr, "Invalid latency list %s\n", optarg);
+                print_help_and_exit();
+            }
+            break;
+        case 'e':
+            event_log_path = optarg;
+            break;
+        case 's':
+            stats_json_path = optarg;
+            break;
+        case 'c':
+            checkpoint_path = optarg;
+            break;
+        case 'n':
+            // Half the range leaves room to round the cycle count up to the next multiple
+            checkpoint_interval = parse_bounded_value("-n", optarg, 1, UINT64_MAX / 2);
+            break;
+        case 'C':
+            resume_path = optarg;
+            break;
+        case 't':
+            thread_count = parse_bounded_value("-t", optarg, 1, MAX_WORKER_THREADS);
+            break;
+        case 'p':
+            sampling.sample_count = parse_bounded_value("-p", optarg, 2, MAX_SAMPLE_COUNT);
+            break;
+        case 'u':
+            sampling.unit_length = parse_bounded_value("-u", optarg, 1, MAX_SAMPLING_LENGTH);
+            break;
+        case 'w':
+            sampling.warmup_length = parse_bounded_value("-w", optarg, 0, MAX_SAMPLING_LENGTH);
+            break;
+        case 'P':
+            interval_count = parse_bounded_value("-P", optarg, 1, UINT64_MAX);
+            break;
+        case 'S':
+            prefetch_trace = false;
+            break;
+        case 'D':
+            cache_directory = optarg;
+            break;
+        case 'M':
+            // Capped so the limit still fits in bytes
+            cache_megabytes = parse_bounded_value("-M", optarg, 1, UINT64_MAX >> 20);
+            break;
+        case 'H':
+            // Counters only see this thread, so the trace is read here for fetch to carry its cost
+            host_counters = true;
+            prefetch_trace = false;
+            break;
+        case 'W':
+            watchdog_cycles = parse_bounded_value("-W", optarg, 1, UINT64_MAX);
             break;
         case 'i':
+            tracePath = optarg;
+            if (is_binary_trace_file(optarg)) {
+                if (!mappedTrace.open(optarg)) {
+                    print_help_and_exit();
+                }
+                delete mappedTraceSource;
+                mappedTraceSource = new memory_trace_source(mappedTrace.records(), mappedTrace.size());
+                break;
+            }
+            if (is_compressed_trace_file(optarg)) {
+                if (!compressedTrace.open(optarg)) {
+                    print_help_and_exit();
+                }
+                useCompressedTrace = true;
+                break;
+            }
             inFile = fopen(optarg, "r");
             if (inFile == NULL)
             {
@@ -98,33 +453,187 @@ int main(int argc, char* argv[]) {
     // printf("\n");
     // */
 
-    /* Setup the processor */
-    setup_proc(r, k0, k1, k2, f);
+    /* Sweep mode: more than one configuration requested */
+    std::vector<proc_config_t> configs = build_config_grid(r, k0, k1, k2, f);
+    for (proc_config_t& config : configs) {
+        config.architectural_registers = architectural_registers;
+        config.watchdog_cycles = watchdog_cycles;
+        std::copy(fu_latency, fu_latency + 3, config.fu_latency);
+        std::copy(fu_pipelined, fu_pipelined + 3, config.fu_pipelined);
+    }
+    if (host_counters && (configs.size() > 1 || sampling.sample_count > 0 || interval_count > 0)) {
+        fprintf(stderr, "-H is ignored for sweeps, sampling and intervals\n");
+    }
+    if (sampling.sample_count > 0 || interval_count > 0) {
+        if (configs.size() > 1) {
+            fprintf(stderr, "Sampling and interval simulation take a single configuration\n");
+            return 1;
+        }
+        if (interval_count > 0) {
+            return run_intervals(configs[0], interval_count, sampling.warmup_length, thread_count);
+        }
+        return run_sampling(configs[0], sampling, thread_count);
+    }
+    if (configs.size() > 1) {
+        if (stats_json_path != NULL) {
+            fprintf(stderr, "-s is ignored for sweeps\n");
+        }
+        return run_sweep(configs, thread_count, prefetch_trace);
+    }
+
+    /*
+     * Result cache. Runs that write checkpoints or resume are not cached,
+     * and -s and -H need measurements the cache does not keep, so they
+     * always simulate but still store the result.
+     */
+    result_cache_t result_cache;
+    result_cache_key_t cache_key;
+    bool use_result_cache = false;
+    if (cache_directory != NULL) {
+        if (checkpoint_path != NULL || resume_path != NULL) {
+            fprintf(stderr, "-D is ignored with -c and -C\n");
+        } else {
+            use_result_cache = open_result_cache(result_cache, cache_directory, cache_megabytes, configs[0], &cache_key);
+        }
+    }
+    sweep_result_t cached_result;
+    if (use_result_cache && stats_json_path == NULL && !host_counters && result_cache.lookup(cache_key, &cached_result, event_log_path)) {
+        if (cached_result.watchdog_expired) {
+            fprintf(stderr, "No instruction retired for %" PRIu64 " cycles (cycle %" PRIu64 "); "
+                    "the configuration cannot drain the trace\n", watchdog_cycles, cached_result.stats.cycle_count - 1);
+            return 1;
+        }
+        printf("%" PRIu64 "\n", cached_result.stats.cycle_count - 1);
+        return 0;
+    }
+
+    /*
+     * Setup the processor. A source that can report and seek its position
+     * supports checkpoints and keeps a long dispatch backlog out of memory;
+     * text traces on a stdin pipe fall back to holding it all.
+     */
+    file_trace_source text_trace_source(inFile);
+    instruction_source* fetch_source = &text_trace_source;
+    if (mappedTraceSource != NULL) {
+        fetch_source = mappedTraceSource;
+    } else if (useCompressedTrace) {
+        fetch_source = &compressedTrace;
+    }
+
+    // Parsing and decoding overlap the simulation on a second core; mapped traces need neither
+    std::unique_ptr<prefetching_trace_source> trace_prefetcher;
+    if (prefetch_trace && mappedTraceSource == NULL && std::thread::hardware_concurrency() > 1) {
+        trace_prefetcher.reset(new prefetching_trace_source(fetch_source));
+        fetch_source = trace_prefetcher.get();
+    }
+    setup_proc(configs[0], fetch_source);
+
+    event_log_writer_t event_log;
+    if (event_log_path != NULL) {
+        if (!event_log.open(event_log_path)) {
+            return 1;
+        }
+        setup_proc_event_log(&event_log);
+    }
+
+    stall_counters_t stall_counters;
+    if (stats_json_path != NULL) {
+        setup_proc_stall_counters(&stall_counters);
+    }
+
+    stage_perf_counters_t stage_perf_counters;
+    if (host_counters) {
+        stage_perf_counters.open();
+        setup_proc_stage_probe(&stage_perf_counters);
+    }
 
     /* Setup statistics */
     proc_stats_t stats;
     memset(&stats, 0, sizeof(proc_stats_t));
 
+    if (resume_path != NULL && !restore_proc_checkpoint(resume_path)) {
+        return 1;
+    }
+
     /* Run the processor */
-    run_proc(&stats);
+    if (checkpoint_path != NULL) {
+        // Pause at every multiple of the interval to save the state
+        while (!run_proc_until(&stats, (stats.cycle_count / checkpoint_interval + 1) * checkpoint_interval - 1)) {
+            if (!save_proc_checkpoint(checkpoint_path)) {
+                return 1;
+            }
+        }
+    } else {
+        run_proc(&stats);
+    }
 
     /* Finalize stats */
     complete_proc(&stats);
+    if (host_counters) {
+        stage_perf_counters.report(stderr);
+    }
+    if (trace_prefetcher) {
+        trace_prefetcher->stop();
+    }
+
+    if (useCompressedTrace && compressedTrace.failed()) {
+        return 1;
+    }
+
+    if (use_result_cache) {
+        cached_result.stats = stats;
+        cached_result.watchdog_expired = proc_watchdog_expired();
+    }
+
+    if (proc_watchdog_expired()) {
+        if (use_result_cache) {
+            result_cache.store(cache_key, cached_result, NULL);
+        }
+        fprintf(stderr, "No instruction retired for %" PRIu64 " cycles (cycle %" PRIu64 "); "
+                "the configuration cannot drain the trace\n", watchdog_cycles, stats.cycle_count - 1);
+        return 1;
+    }
+
+    if (!event_log.close()) {
+        fprintf(stderr, "Failed to write %s\n", event_log_path);
+        return 1;
+    }
+
+    if (use_result_cache) {
+        result_cache.store(cache_key, cached_result, event_log_path);
+    }
+
+    if (stats_json_path != NULL) {
+        bool to_stdout = strcmp(stats_json_path, "-") == 0;
+        FILE* json_file = to_stdout ? stdout : fopen(stats_json_path, "w");
+        if (json_file == NULL) {
+            fprintf(stderr, "Failed to open %s for writing\n", stats_json_path);
+            return 1;
+        }
+        bool write_ok = write_stats_json(json_file, configs[0], stats, stall_counters);
+        if (!to_stdout) write_ok = (fclose(json_file) == 0) && write_ok;
+        if (!write_ok) {
+            fprintf(stderr, "Failed to write %s\n", stats_json_path);
+            return 1;
+        }
+    }
 
     // Comment this out when submitting to gradescope
     // print_statistics(&stats);
 
-    printf("%lu\n",stats.cycle_count - 1);
+    // With -s - stdout carries only the JSON, so the cycle count goes to stderr
+    bool json_on_stdout = stats_json_path != NULL && strcmp(stats_json_path, "-") == 0;
+    fprintf(json_on_stdout ? stderr : stdout, "%" PRIu64 "\n", stats.cycle_count - 1);
 
     return 0;
 }
 
 void print_statistics(proc_stats_t* p_stats) {
     printf("Processor stats:\n");
-	printf("Total instructions: %lu\n", p_stats->retired_instruction);
+	printf("Total instructions: %" PRIu64 "\n", p_stats->retired_instruction);
         printf("Avg Dispatch queue size: %f\n", p_stats->avg_disp_size);
-        printf("Maximum Dispatch queue size: %lu\n", p_stats->max_disp_size);
+        printf("Maximum Dispatch queue size: %" PRIu64 "\n", p_stats->max_disp_size);
         printf("Avg inst fired per cycle: %f\n", p_stats->avg_inst_fired);
 	printf("Avg inst retired per cycle: %f\n", p_stats->avg_inst_retired);
-	printf("Total run time (cycles): %lu\n", p_stats->cycle_count-1);
+	printf("Total run time (cycles): %" PRIu64 "\n", p_stats->cycle_count-1);
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "procsim_embed.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+embedded_proc_sim_t::embedded_proc_sim_t(const proc_config_t& config)
+    : simulator(config, &instruction_queue), pushed_count(0), simulation_finished(false)
+{
+    memset(&running_statistics, 0, sizeof(running_statistics));
+}
+
+bool embedded_proc_sim_t::push_instruction(uint32_t instruction_address, int32_t op_code, int32_t dest_reg,
+                                           int32_t src_reg0, int32_t src_reg1)
+{
+    if (instruction_queue.finished()) {
+        fprintf(stderr, "Cannot push instruction %x after the end of the trace\n", instruction_address);
+        return false;
+    }
+
+    proc_inst_t inst;
+    memset(&inst, 0, sizeof(inst));
+    inst.instruction_address = instruction_address;
+    inst.op_code = op_code;
+    inst.dest_reg = dest_reg;
+    inst.src_reg[0] = src_reg0;
+    inst.src_reg[1] = src_reg1;
+    instruction_queue.push(inst);
+    pushed_count++;
+    return true;
+}
+
+bool embedded_proc_sim_t::step_cycles(uint64_t cycle_count)
+{
+    if (simulation_finished || cycle_count == 0) return simulation_finished;
+
+    uint64_t completed_cycles = simulator.simulated_cycle_count();
+    uint64_t last_cycle = cycle_count > UINT64_MAX - completed_cycles ? UINT64_MAX : completed_cycles + cycle_count;
+    simulation_finished = simulator.run_until(&running_statistics, last_cycle);
+    return simulation_finished;
+}
+
+bool embedded_proc_sim_t::step_until_retired(uint64_t retired_count)
+{
+    // Instructions not pushed yet cannot retire; waiting for them would only run into the watchdog
+    if (!instruction_queue.finished()) {
+        retired_count = std::min(retired_count, pushed_count);
+    }
+    if (simulation_finished || simulator.retired_instruction_count() >= retired_count) return simulation_finished;
+
+    simulation_finished = simulator.run_until_retired(&running_statistics, retired_count);
+    return simulation_finished;
+}
+
+void embedded_proc_sim_t::statistics(proc_stats_t* p_stats) const
+{
+    *p_stats = running_statistics;
+    simulator.complete(p_stats);
+}
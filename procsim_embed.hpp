@@ -0,0 +1,93 @@
+#ifndef PROCSIM_EMBED_HPP
+#define PROCSIM_EMBED_HPP
+
+#include <cstdint>
+#include <deque>
+
+#include "procsim.hpp"
+
+//
+// pushed_instruction_source
+//
+//  Instructions queued by the caller. Until finish() marks the end of the
+//  trace, running out of queued instructions stalls fetch instead of
+//  ending the trace.
+//
+class pushed_instruction_source : public instruction_source
+{
+public:
+    pushed_instruction_source() : trace_finished(false) {}
+
+    void push(const proc_inst_t& inst) { pending_instructions.push_back(inst); }
+    void finish() { trace_finished = true; }
+    bool finished() const { return trace_finished; }
+    uint64_t pending_count() const { return pending_instructions.size(); }
+
+    bool read(proc_inst_t* p_inst)
+    {
+        if (pending_instructions.empty()) return false;
+        *p_inst = pending_instructions.front();
+        pending_instructions.pop_front();
+        return true;
+    }
+
+    bool awaiting_instructions() const { return !trace_finished; }
+
+private:
+    std::deque<proc_inst_t> pending_instructions;
+    bool trace_finished;
+};
+
+//
+// embedded_proc_sim_t
+//
+//  In-process simulator for co-simulation and other embedding. The caller
+//  pushes instructions as they become known, steps the pipeline by cycles
+//  or retirements, and reads live statistics between steps. finish_trace()
+//  marks the end of the program so the pipeline can drain and finish.
+//  Nothing is read from stdin and nothing is printed except errors.
+//
+class embedded_proc_sim_t
+{
+public:
+    explicit embedded_proc_sim_t(const proc_config_t& config);
+
+    // Queues one instruction behind those already pushed; fails once the trace is finished
+    bool push_instruction(uint32_t instruction_address, int32_t op_code, int32_t dest_reg,
+                          int32_t src_reg0, int32_t src_reg1);
+
+    // No further instructions follow; the simulation finishes once the pipeline drains
+    void finish_trace() { instruction_queue.finish(); }
+
+    // Simulates up to cycle_count more cycles; returns true once the simulation has finished
+    bool step_cycles(uint64_t cycle_count);
+
+    // Simulates until the first retired_count instructions have retired, or only as many as were
+    // pushed while the trace is unfinished; returns true once the simulation has finished
+    bool step_until_retired(uint64_t retired_count);
+
+    // Statistics so far, as complete_proc would report them if the run ended now
+    void statistics(proc_stats_t* p_stats) const;
+
+    bool finished() const { return simulation_finished; }
+    bool watchdog_expired() const { return simulator.watchdog_expired(); }
+    uint64_t simulated_cycle_count() const { return simulator.simulated_cycle_count(); }
+    uint64_t retired_instruction_count() const { return simulator.retired_instruction_count(); }
+    uint64_t pushed_instruction_count() const { return pushed_count; }
+    uint64_t pending_instruction_count() const { return instruction_queue.pending_count(); }
+
+    // The underlying simulator, to attach an event log, stage probe or stall counters
+    proc_sim_t& core() { return simulator; }
+
+private:
+    embedded_proc_sim_t(const embedded_proc_sim_t&);
+    embedded_proc_sim_t& operator=(const embedded_proc_sim_t&);
+
+    pushed_instruction_source instruction_queue;
+    proc_sim_t simulator;
+    proc_stats_t running_statistics;
+    uint64_t pushed_count;
+    bool simulation_finished;
+};
+
+#endif /* PROCSIM_EMBED_HPP */
@@ -0,0 +1,147 @@
+#include "procsim_interval.hpp"
+#include "procsim_sample.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Shortest stretch of instructions measured on each side of a boundary for the error estimate
+#define INTERVAL_MINIMUM_PROBE_LENGTH 32
+
+// Per-interval outcome, combined once every worker has finished
+typedef struct _interval_outcome_t
+{
+    uint64_t cycles;
+    uint64_t fired_instructions;
+    uint64_t start_probe_cycles;      // Charge for the interval's first probe_length instructions
+    uint64_t next_probe_cycles;       // Charge for the next interval's first instructions, run as cooldown
+    double dispatch_queue_size_sum;   // avg_disp_size weighted by the run's cycles
+    uint64_t run_cycles;
+    uint64_t max_disp_size;
+    bool finished;
+} interval_outcome_t;
+
+// Instructions measured after a boundary to compare both neighbours' charge for them
+static uint64_t probe_length(uint64_t warmup_length, uint64_t interval_length)
+{
+    return std::min(std::max(warmup_length / 2, (uint64_t)INTERVAL_MINIMUM_PROBE_LENGTH), interval_length);
+}
+
+//
+// simulate_interval
+//
+//  Runs [start - warmup, end + cooldown) in detail. The interval is charged
+//  the cycles between the retirement of the instruction before its start
+//  and of its last instruction; the cooldown keeps the instructions after
+//  it competing for resources as they would in the serial run. The cooldown
+//  also covers the first instructions of the next interval, whose charge
+//  here is compared with the next interval's own charge for them.
+//
+static void simulate_interval(const trace_record_t* trace_records, uint64_t trace_length, uint64_t interval_start,
+                              uint64_t interval_length, uint64_t next_probe_length, uint64_t warmup_length,
+                              const proc_config_t& config, interval_outcome_t* p_outcome)
+{
+    uint64_t warmup = std::min(warmup_length, interval_start);
+    uint64_t interval_end = interval_start + interval_length;
+    uint64_t cooldown = std::min(std::max(warmup_length, next_probe_length), trace_length - interval_end);
+    uint64_t start_probe_length = probe_length(warmup_length, interval_length);
+
+    retirement_point_t points[4];
+    points[0].retired_count = warmup;
+    points[1].retired_count = warmup + start_probe_length;
+    points[2].retired_count = warmup + interval_length;
+    points[3].retired_count = warmup + interval_length + next_probe_length;
+
+    proc_stats_t run_stats;
+    p_outcome->finished = simulate_retirement_points(trace_records + interval_start - warmup,
+                                                     warmup + interval_length + cooldown, config, points, 4, &run_stats);
+    if (!p_outcome->finished) return;
+
+    p_outcome->cycles = points[2].cycle - points[0].cycle;
+    p_outcome->fired_instructions = points[2].fired_instructions - points[0].fired_instructions;
+    p_outcome->start_probe_cycles = points[1].cycle - points[0].cycle;
+    p_outcome->next_probe_cycles = points[3].cycle - points[2].cycle;
+    p_outcome->run_cycles = run_stats.cycle_count;
+    p_outcome->dispatch_queue_size_sum = (double)run_stats.avg_disp_size * (double)run_stats.cycle_count;
+    p_outcome->max_disp_size = run_stats.max_disp_size;
+}
+
+bool run_interval_simulation(const trace_record_t* trace_records, uint64_t trace_length,
+                             const proc_config_t& config, uint64_t interval_count, uint64_t warmup_length,
+                             unsigned thread_count, interval_result_t* p_result)
+{
+    memset(p_result, 0, sizeof(interval_result_t));
+    if (interval_count == 0 || interval_count > trace_length) {
+        fprintf(stderr, "Trace of %lu instructions cannot be split into %lu intervals\n",
+                (unsigned long)trace_length, (unsigned long)interval_count);
+        return false;
+    }
+
+    uint64_t interval_length = trace_length / interval_count;
+    std::vector<interval_outcome_t> outcomes(interval_count);
+
+    if (thread_count == 0) {
+        thread_count = std::thread::hardware_concurrency();
+        if (thread_count == 0) thread_count = 1;
+    }
+    if (thread_count > interval_count) thread_count = interval_count;
+
+    std::atomic<size_t> next_interval_index(0);
+    auto worker = [&]() {
+        size_t interval_index;
+        while ((interval_index = next_interval_index.fetch_add(1)) < interval_count) {
+            // The last interval takes the remainder
+            uint64_t interval_start = interval_index * interval_length;
+            uint64_t length = interval_index + 1 == interval_count ? trace_length - interval_start : interval_length;
+            uint64_t next_length = interval_index + 2 == interval_count ? trace_length - interval_start - length : interval_length;
+            uint64_t next_probe_length = interval_index + 1 == interval_count ? 0 : probe_length(warmup_length, next_length);
+            simulate_interval(trace_records, trace_length, interval_start, length, next_probe_length, warmup_length,
+                              config, &outcomes[interval_index]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned thread_index = 1; thread_index < thread_count; thread_index++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& worker_thread : workers) {
+        worker_thread.join();
+    }
+
+    uint64_t total_cycles = 0;
+    uint64_t total_fired_instructions = 0;
+    uint64_t total_run_cycles = 0;
+    double dispatch_queue_size_sum = 0;
+    for (size_t interval_index = 0; interval_index < interval_count; interval_index++) {
+        const interval_outcome_t& outcome = outcomes[interval_index];
+        if (!outcome.finished) {
+            fprintf(stderr, "An interval tripped the watchdog; the configuration cannot drain the trace\n");
+            return false;
+        }
+        total_cycles += outcome.cycles;
+        total_fired_instructions += outcome.fired_instructions;
+        total_run_cycles += outcome.run_cycles;
+        dispatch_queue_size_sum += outcome.dispatch_queue_size_sum;
+        p_result->stats.max_disp_size = std::max(p_result->stats.max_disp_size, outcome.max_disp_size);
+
+        // Both neighbours charge the instructions just after a boundary; a warm-up too short shows up as disagreement
+        if (interval_index > 0) {
+            uint64_t own_charge = outcome.start_probe_cycles;
+            uint64_t warm_charge = outcomes[interval_index - 1].next_probe_cycles;
+            p_result->estimated_error_cycles += own_charge > warm_charge ? own_charge - warm_charge : warm_charge - own_charge;
+        }
+    }
+
+    p_result->interval_count = interval_count;
+    p_result->stats.cycle_count = total_cycles + 1;
+    p_result->stats.retired_instruction = trace_length;
+    if (total_cycles > 0) {
+        p_result->stats.avg_inst_retired = (double)trace_length / (double)p_result->stats.cycle_count;
+        p_result->stats.avg_inst_fired = (double)total_fired_instructions / (double)p_result->stats.cycle_count;
+        p_result->stats.avg_disp_size = dispatch_queue_size_sum / (double)total_run_cycles;
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef PROCSIM_INTERVAL_HPP
+#define PROCSIM_INTERVAL_HPP
+
+#include <cstdint>
+
+#include "procsim.hpp"
+#include "procsim_trace.hpp"
+
+typedef struct _interval_result_t
+{
+    uint64_t interval_count;
+    proc_stats_t stats;           // Stitched whole-trace statistics; cycle_count follows the run_proc convention
+    uint64_t estimated_error_cycles;  // Boundary disagreement, a hint at |stitched - serial| cycles but not a bound
+} interval_result_t;
+
+//
+// run_interval_simulation
+//
+//  Splits the trace into interval_count contiguous intervals and simulates
+//  them concurrently on thread_count worker threads (0 selects one per
+//  hardware thread). Every interval is simulated with the warmup_length
+//  instructions before it, which rebuild the in-flight pipeline state the
+//  serial run would have at its start, and as many after it, which keep
+//  competing with its last instructions. It is charged the cycles between
+//  the retirement of the instruction before it and of its own last
+//  instruction; the whole-trace cycle count is the sum.
+//
+//  The estimated error sums, over the boundaries, the disagreement between
+//  the two neighbouring runs on the cycles charged to the first
+//  instructions of the later interval: the earlier run reaches them fully
+//  warmed, the later one after only its warm-up. It is a heuristic, not a
+//  bound; a short warm-up can miss error that shows up further in.
+//
+//  avg_disp_size and max_disp_size come from the interval runs: the
+//  dispatch backlog of a serial run grows over the whole trace, and the
+//  intervals do not reproduce it. Returns false if an interval trips the
+//  watchdog.
+//
+bool run_interval_simulation(const trace_record_t* trace_records, uint64_t trace_length,
+                             const proc_config_t& config, uint64_t interval_count, uint64_t warmup_length,
+                             unsigned thread_count, interval_result_t* p_result);
+
+#endif /* PROCSIM_INTERVAL_HPP */
@@ -0,0 +1,109 @@
+#include "procsim.hpp"
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+//
+// Legacy global interface
+//
+//  setup_proc/run_proc/complete_proc drive one process-wide simulator
+//  instance. Kept apart from the simulator core so programs that only use
+//  proc_sim_t never need to provide read_instruction().
+//
+
+// Trace source adapter feeding the legacy global simulator from read_instruction()
+class driver_instruction_source : public instruction_source
+{
+public:
+    bool read(proc_inst_t* p_inst) { return read_instruction(p_inst); }
+};
+
+// Simulator instance backing the setup_proc/run_proc/complete_proc interface
+static driver_instruction_source legacy_instruction_source;
+static proc_sim_t* legacy_simulator = NULL;
+
+void setup_proc(uint64_t result_buses_param, uint64_t fu_type0_param, uint64_t fu_type1_param, uint64_t fu_type2_param, uint64_t fetch_width_param) {
+    proc_config_t config;
+    config.result_buses = result_buses_param;
+    config.fu_type0 = fu_type0_param;
+    config.fu_type1 = fu_type1_param;
+    config.fu_type2 = fu_type2_param;
+    config.fetch_width = fetch_width_param;
+    config.architectural_registers = DEFAULT_ARCH_REGS;
+    config.watchdog_cycles = DEFAULT_WATCHDOG_CYCLES;
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        config.fu_latency[functional_unit_type_id] = DEFAULT_FU_LATENCY;
+        config.fu_pipelined[functional_unit_type_id] = false;
+    }
+    setup_proc(config);
+}
+
+void setup_proc(const proc_config_t& config) {
+    setup_proc(config, &legacy_instruction_source);
+}
+
+void setup_proc(const proc_config_t& config, instruction_source* source) {
+    delete legacy_simulator;
+    legacy_simulator = new proc_sim_t(config, source);
+}
+
+void setup_proc_event_log(event_log_writer_t* log) {
+    legacy_simulator->attach_event_log(log);
+}
+
+void setup_proc_stage_probe(stage_probe_t* probe) {
+    legacy_simulator->attach_stage_probe(probe);
+}
+
+void setup_proc_stall_counters(stall_counters_t* counters) {
+    legacy_simulator->attach_stall_counters(counters);
+}
+
+void run_proc(proc_stats_t* processor_statistics) {
+    legacy_simulator->run(processor_statistics);
+}
+
+bool run_proc_until(proc_stats_t* processor_statistics, uint64_t last_cycle) {
+    return legacy_simulator->run_until(processor_statistics, last_cycle);
+}
+
+bool proc_watchdog_expired() {
+    return legacy_simulator->watchdog_expired();
+}
+
+bool save_proc_checkpoint(const char* path) {
+    // Write beside the target and rename over it, so a crash mid-write keeps the previous checkpoint
+    std::string temporary_path = std::string(path) + ".tmp";
+    FILE* checkpoint_file = fopen(temporary_path.c_str(), "wb");
+    if (checkpoint_file == NULL) {
+        fprintf(stderr, "Failed to open %s for writing\n", temporary_path.c_str());
+        return false;
+    }
+
+    bool write_ok = legacy_simulator->save_checkpoint(checkpoint_file);
+    write_ok = (fsync(fileno(checkpoint_file)) == 0) && write_ok;
+    write_ok = (fclose(checkpoint_file) == 0) && write_ok;
+    if (!write_ok || rename(temporary_path.c_str(), path) != 0) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        remove(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool restore_proc_checkpoint(const char* path) {
+    FILE* checkpoint_file = fopen(path, "rb");
+    if (checkpoint_file == NULL) {
+        fprintf(stderr, "Failed to open %s for reading\n", path);
+        return false;
+    }
+    setvbuf(checkpoint_file, NULL, _IOFBF, 1 << 20);
+
+    bool restored = legacy_simulator->restore_checkpoint(checkpoint_file);
+    fclose(checkpoint_file);
+    return restored;
+}
+
+void complete_proc(proc_stats_t* final_statistics) {
+    legacy_simulator->complete(final_statistics);
+}
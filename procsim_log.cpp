@@ -0,0 +1,104 @@
+#include "procsim_log.hpp"
+#include <cinttypes>
+#include <cstring>
+
+// Events buffered between writes to the log file
+#define EVENT_LOG_BUFFER_EVENTS 8192
+
+void write_golden_log_line(FILE* text_file, const pipeline_event_t& event)
+{
+    fprintf(text_file, "%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\n",
+            event.tag, event.fetch_cycle, event.dispatch_cycle, event.schedule_cycle,
+            event.execute_cycle, event.state_update_cycle);
+}
+
+bool event_log_writer_t::open(const char* path)
+{
+    close();
+
+    log_file = fopen(path, "wb");
+    if (log_file == NULL) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    char magic[8];
+    memset(magic, 0, sizeof(magic));
+    memcpy(magic, EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC));
+    fwrite(magic, sizeof(magic), 1, log_file);
+
+    event_buffer.resize(EVENT_LOG_BUFFER_EVENTS);
+    buffered_event_count = 0;
+    return true;
+}
+
+void event_log_writer_t::flush()
+{
+    if (buffered_event_count > 0) {
+        fwrite(event_buffer.data(), sizeof(pipeline_event_t), buffered_event_count, log_file);
+    }
+    buffered_event_count = 0;
+}
+
+bool event_log_writer_t::close()
+{
+    if (log_file == NULL) return true;
+
+    flush();
+    bool write_ok = !ferror(log_file);
+    write_ok = (fclose(log_file) == 0) && write_ok;
+    log_file = NULL;
+    return write_ok;
+}
+
+bool event_log_reader_t::open(const char* path)
+{
+    close();
+
+    log_file = fopen(path, "rb");
+    if (log_file == NULL) {
+        fprintf(stderr, "Failed to open %s for reading\n", path);
+        return false;
+    }
+    setvbuf(log_file, NULL, _IOFBF, 1 << 20);
+
+    char magic[8];
+    is_binary = fread(magic, sizeof(magic), 1, log_file) == 1 &&
+                memcmp(magic, EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC)) == 0;
+    line_number = 0;
+    read_failed = false;
+
+    if (!is_binary) {
+        // Golden text log: skip past the column header
+        rewind(log_file);
+        int next_char;
+        while ((next_char = fgetc(log_file)) != EOF && next_char != '\n') {}
+        line_number = 1;
+    }
+    return true;
+}
+
+void event_log_reader_t::close()
+{
+    if (log_file != NULL) {
+        fclose(log_file);
+    }
+    log_file = NULL;
+}
+
+bool event_log_reader_t::read(pipeline_event_t* p_event)
+{
+    line_number++;
+    if (is_binary) {
+        size_t byte_count = fread(p_event, 1, sizeof(pipeline_event_t), log_file);
+        // Anything but a whole record or a clean end of file means the log was cut short or unreadable
+        read_failed = byte_count != sizeof(pipeline_event_t) && (byte_count != 0 || ferror(log_file));
+        return byte_count == sizeof(pipeline_event_t);
+    }
+
+    int ret = fscanf(log_file, "%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64,
+                     &p_event->tag, &p_event->fetch_cycle, &p_event->dispatch_cycle,
+                     &p_event->schedule_cycle, &p_event->execute_cycle, &p_event->state_update_cycle);
+    read_failed = ret != 6 && (ret != EOF || ferror(log_file));
+    return ret == 6;
+}
@@ -0,0 +1,110 @@
+#ifndef PROCSIM_LOG_HPP
+#define PROCSIM_LOG_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "procsim.hpp"
+
+// Stage timestamps of one retired instruction
+typedef struct _pipeline_event_t
+{
+    uint64_t tag;
+    uint64_t fetch_cycle;
+    uint64_t dispatch_cycle;
+    uint64_t schedule_cycle;
+    uint64_t execute_cycle;
+    uint64_t state_update_cycle;
+} pipeline_event_t;
+
+//
+// Binary event log layout (host byte order): the 8-byte magic followed by
+// pipeline_event_t records in tag order
+//
+#define EVENT_LOG_MAGIC "PSIMLOG"
+
+// Column header and line format of the golden per-instruction text logs
+#define GOLDEN_LOG_HEADER "INST\tFETCH\tDISP\tSCHED\tEXEC\tSTATE\n"
+
+// Copies the stage timestamps of an instruction into an event record
+inline void instruction_to_pipeline_event(const proc_inst_t& instruction, pipeline_event_t* p_event)
+{
+    p_event->tag = instruction.tag;
+    p_event->fetch_cycle = instruction.fetch_cycle;
+    p_event->dispatch_cycle = instruction.dispatch_cycle;
+    p_event->schedule_cycle = instruction.schedule_cycle;
+    p_event->execute_cycle = instruction.execute_cycle;
+    p_event->state_update_cycle = instruction.state_update_cycle;
+}
+
+// Writes one event as a golden text log line
+void write_golden_log_line(FILE* text_file, const pipeline_event_t& event);
+
+//
+// event_log_writer_t
+//
+//  Buffers events in memory and hands them to stdio in large blocks, so
+//  logging costs a record copy per retired instruction
+//
+class event_log_writer_t
+{
+public:
+    event_log_writer_t() : log_file(NULL), buffered_event_count(0) {}
+    ~event_log_writer_t() { close(); }
+
+    bool open(const char* path);
+    bool close();
+
+    void append(const pipeline_event_t& event)
+    {
+        event_buffer[buffered_event_count++] = event;
+        if (buffered_event_count == event_buffer.size()) flush();
+    }
+
+private:
+    event_log_writer_t(const event_log_writer_t&);
+    event_log_writer_t& operator=(const event_log_writer_t&);
+
+    void flush();
+
+    FILE* log_file;
+    std::vector<pipeline_event_t> event_buffer;
+    size_t buffered_event_count;
+};
+
+//
+// event_log_reader_t
+//
+//  Streams events from either a binary event log or a golden text log,
+//  detected from the first bytes of the file
+//
+class event_log_reader_t
+{
+public:
+    event_log_reader_t() : log_file(NULL), is_binary(false), read_failed(false), line_number(0) {}
+    ~event_log_reader_t() { close(); }
+
+    bool open(const char* path);
+    void close();
+
+    // Reads the next event, returns false at end of log or on a malformed line or short record
+    bool read(pipeline_event_t* p_event);
+
+    // True if the last read stopped on a malformed line or short record rather than the end of the log
+    bool failed() const { return read_failed; }
+
+    // Golden text line of the last event read (record number for binary logs)
+    uint64_t position() const { return line_number; }
+
+private:
+    event_log_reader_t(const event_log_reader_t&);
+    event_log_reader_t& operator=(const event_log_reader_t&);
+
+    FILE* log_file;
+    bool is_binary;
+    bool read_failed;
+    uint64_t line_number;
+};
+
+#endif /* PROCSIM_LOG_HPP */
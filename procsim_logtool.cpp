@@ -0,0 +1,117 @@
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "procsim_log.hpp"
+
+void print_help_and_exit(void) {
+    printf("procsim_logtool text events.plog\n");
+    printf("  Print a binary event log in the golden per-instruction text format\n");
+    printf("procsim_logtool diff golden.log events.plog\n");
+    printf("  Report the first divergence between two logs (binary or golden text)\n");
+    exit(1);
+}
+
+// Stage timestamps of an event in golden log column order
+static void pipeline_event_fields(const pipeline_event_t& event, uint64_t fields[6])
+{
+    fields[0] = event.tag;
+    fields[1] = event.fetch_cycle;
+    fields[2] = event.dispatch_cycle;
+    fields[3] = event.schedule_cycle;
+    fields[4] = event.execute_cycle;
+    fields[5] = event.state_update_cycle;
+}
+
+// Reports a log that stopped on a malformed line or short record, returns true if it did
+static bool report_read_failure(const event_log_reader_t& reader, const char* log_path)
+{
+    if (!reader.failed()) return false;
+    fprintf(stderr, "%s is malformed or truncated at line %" PRIu64 "\n", log_path, reader.position());
+    return true;
+}
+
+//
+// convert_to_text
+//
+//  Streams a binary event log to stdout as a golden text log
+//
+int convert_to_text(const char* log_path) {
+    event_log_reader_t reader;
+    if (!reader.open(log_path)) return 1;
+
+    setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+    printf(GOLDEN_LOG_HEADER);
+
+    pipeline_event_t event;
+    while (reader.read(&event)) {
+        write_golden_log_line(stdout, event);
+    }
+    return report_read_failure(reader, log_path) ? 1 : 0;
+}
+
+//
+// diff_logs
+//
+//  Compares two logs event by event without loading either; exits 0 if
+//  they match, 1 at the first divergence and 2 if either cannot be read
+//  to its end
+//
+int diff_logs(const char* expected_path, const char* actual_path) {
+    event_log_reader_t expected_reader;
+    event_log_reader_t actual_reader;
+    if (!expected_reader.open(expected_path) || !actual_reader.open(actual_path)) return 2;
+
+    static const char* field_names[6] = { "INST", "FETCH", "DISP", "SCHED", "EXEC", "STATE" };
+    uint64_t event_count = 0;
+
+    while (true) {
+        pipeline_event_t expected_event;
+        pipeline_event_t actual_event;
+        bool has_expected = expected_reader.read(&expected_event);
+        bool has_actual = actual_reader.read(&actual_event);
+        bool expected_failed = report_read_failure(expected_reader, expected_path);
+        bool actual_failed = report_read_failure(actual_reader, actual_path);
+        if (expected_failed || actual_failed) return 2;
+
+        if (!has_expected && !has_actual) break;
+        if (has_expected != has_actual) {
+            printf("Logs diverge after %" PRIu64 " instructions: %s ends first\n",
+                   event_count, has_expected ? actual_path : expected_path);
+            return 1;
+        }
+
+        uint64_t expected_fields[6];
+        uint64_t actual_fields[6];
+        pipeline_event_fields(expected_event, expected_fields);
+        pipeline_event_fields(actual_event, actual_fields);
+        for (int field_index = 0; field_index < 6; field_index++) {
+            if (expected_fields[field_index] != actual_fields[field_index]) {
+                printf("First divergence at instruction %" PRIu64 " (%s line %" PRIu64 ", %s line %" PRIu64 "):\n",
+                       expected_event.tag, expected_path, expected_reader.position(), actual_path, actual_reader.position());
+                printf("  %s expected %" PRIu64 ", got %" PRIu64 "\n", field_names[field_index],
+                       expected_fields[field_index], actual_fields[field_index]);
+                printf("  expected: ");
+                write_golden_log_line(stdout, expected_event);
+                printf("  actual:   ");
+                write_golden_log_line(stdout, actual_event);
+                return 1;
+            }
+        }
+        event_count++;
+    }
+
+    printf("Logs match (%" PRIu64 " instructions)\n", event_count);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 3 && strcmp(argv[1], "text") == 0) {
+        return convert_to_text(argv[2]);
+    }
+    if (argc == 4 && strcmp(argv[1], "diff") == 0) {
+        return diff_logs(argv[2], argv[3]);
+    }
+    print_help_and_exit();
+    return 1;
+}
@@ -0,0 +1,181 @@
+#include "procsim_perf.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+const char* const host_counter_names[HOST_COUNTER_COUNT] = {
+    "cycles", "instructions", "cache misses", "branch misses"
+};
+
+static uint64_t monotonic_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef __linux__
+// Hardware event behind each host counter
+static const uint64_t host_counter_events[HOST_COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+// Layout of a group read with PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+typedef struct _counter_group_read_t
+{
+    uint64_t counter_count;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t values[HOST_COUNTER_COUNT];
+} counter_group_read_t;
+
+// Opens one counter for the calling thread in user mode, in group_fd's group if it is not -1
+static int open_host_counter(uint64_t event, int group_fd)
+{
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = event;
+    attributes.disabled = group_fd == -1 ? 1 : 0;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attributes, 0, -1, group_fd, 0);
+}
+#endif
+
+stage_perf_counters_t::stage_perf_counters_t()
+    : group_leader_fd(-1), open_counter_count(0), multiplexed(false), stage_start_ns(0)
+{
+    for (int counter = 0; counter < HOST_COUNTER_COUNT; counter++) {
+        counter_fd[counter] = -1;
+        group_position[counter] = -1;
+    }
+    memset(stage_start_values, 0, sizeof(stage_start_values));
+    memset(stage_calls, 0, sizeof(stage_calls));
+    memset(stage_ns, 0, sizeof(stage_ns));
+    memset(stage_counts, 0, sizeof(stage_counts));
+}
+
+stage_perf_counters_t::~stage_perf_counters_t()
+{
+    for (int counter = 0; counter < HOST_COUNTER_COUNT; counter++) {
+        if (counter_fd[counter] >= 0) close(counter_fd[counter]);
+    }
+}
+
+//
+// open
+//
+//  Opens the counters as one group, so they are scheduled onto the PMU
+//  together and every read sees the same interval. The first counter that
+//  opens leads the group; later ones the CPU cannot count are skipped.
+//
+bool stage_perf_counters_t::open()
+{
+#ifdef __linux__
+    for (int counter = 0; counter < HOST_COUNTER_COUNT; counter++) {
+        int fd = open_host_counter(host_counter_events[counter], group_leader_fd);
+        if (fd < 0) {
+            if (unavailable_reason.empty()) unavailable_reason = strerror(errno);
+            continue;
+        }
+        if (group_leader_fd < 0) group_leader_fd = fd;
+        counter_fd[counter] = fd;
+        group_position[counter] = open_counter_count++;
+    }
+    if (group_leader_fd < 0) {
+        fprintf(stderr, "Host performance counters are unavailable (%s); reporting stage times only\n",
+                unavailable_reason.c_str());
+        return false;
+    }
+    ioctl(group_leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    if (ioctl(group_leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) {
+        fprintf(stderr, "Failed to start host performance counters: %s\n", strerror(errno));
+        return false;
+    }
+    return true;
+#else
+    unavailable_reason = "not supported on this platform";
+    fprintf(stderr, "Host performance counters are unavailable (%s); reporting stage times only\n",
+            unavailable_reason.c_str());
+    return false;
+#endif
+}
+
+void stage_perf_counters_t::read_counters(uint64_t values[HOST_COUNTER_COUNT])
+{
+#ifdef __linux__
+    counter_group_read_t group;
+    if (group_leader_fd < 0 || read(group_leader_fd, &group, sizeof(group)) <= 0) return;
+    if (group.time_running < group.time_enabled) multiplexed = true;
+    for (int counter = 0; counter < HOST_COUNTER_COUNT; counter++) {
+        if (group_position[counter] >= 0) values[counter] = group.values[group_position[counter]];
+    }
+#else
+    (void)values;
+#endif
+}
+
+void stage_perf_counters_t::begin_stage(proc_stage_t)
+{
+    read_counters(stage_start_values);
+    stage_start_ns = monotonic_ns();
+}
+
+void stage_perf_counters_t::end_stage(proc_stage_t stage)
+{
+    stage_ns[stage] += monotonic_ns() - stage_start_ns;
+    stage_calls[stage]++;
+
+    uint64_t values[HOST_COUNTER_COUNT];
+    memcpy(values, stage_start_values, sizeof(values));
+    read_counters(values);
+    for (int counter = 0; counter < HOST_COUNTER_COUNT; counter++) {
+        stage_counts[stage][counter] += values[counter] - stage_start_values[counter];
+    }
+}
+
+void stage_perf_counters_t::report(FILE* report_file) const
+{
+    fprintf(report_file, "%-10s %10s %10s %14s %14s %6s %14s %14s\n", "stage", "calls", "ms",
+            "cycles", "instructions", "IPC", "cache misses", "branch misses");
+    for (int stage = 0; stage < PROC_STAGE_COUNT; stage++) {
+        fprintf(report_file, "%-10s %10" PRIu64 " %10.1f", proc_stage_names[stage], stage_calls[stage], stage_ns[stage] / 1e6);
+        for (int counter = 0; counter < HOST_COUNTER_COUNT; counter++) {
+            if (counter_fd[counter] < 0) {
+                fprintf(report_file, " %14s", "-");
+            } else {
+                fprintf(report_file, " %14" PRIu64, stage_counts[stage][counter]);
+            }
+            if (counter == HOST_INSTRUCTIONS) {
+                if (counter_fd[HOST_CYCLES] < 0 || counter_fd[HOST_INSTRUCTIONS] < 0 || stage_counts[stage][HOST_CYCLES] == 0) {
+                    fprintf(report_file, " %6s", "-");
+                } else {
+                    fprintf(report_file, " %6.2f", (double)stage_counts[stage][HOST_INSTRUCTIONS] / stage_counts[stage][HOST_CYCLES]);
+                }
+            }
+        }
+        fprintf(report_file, "\n");
+    }
+
+    for (int counter = 0; counter < HOST_COUNTER_COUNT; counter++) {
+        if (group_leader_fd >= 0 && counter_fd[counter] < 0) {
+            fprintf(report_file, "Host counter %s unavailable: %s\n", host_counter_names[counter], unavailable_reason.c_str());
+        }
+    }
+    if (multiplexed) {
+        fprintf(report_file, "Host counters were shared with other users of the PMU; counts cover only the time they ran\n");
+    }
+}
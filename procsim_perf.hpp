@@ -0,0 +1,67 @@
+#ifndef PROCSIM_PERF_HPP
+#define PROCSIM_PERF_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "procsim.hpp"
+
+// Host hardware events counted around each stage
+enum host_counter_t
+{
+    HOST_CYCLES,
+    HOST_INSTRUCTIONS,
+    HOST_CACHE_MISSES,
+    HOST_BRANCH_MISSES,
+    HOST_COUNTER_COUNT
+};
+
+extern const char* const host_counter_names[HOST_COUNTER_COUNT];
+
+//
+// stage_perf_counters_t
+//
+//  Stage probe that reads the host's hardware performance counters
+//  (perf_event_open, user mode, calling thread only) before and after each
+//  stage call and charges the difference to that stage. Counters the
+//  kernel or CPU does not offer are left out and reported as unavailable;
+//  with none at all, only wall-clock time is measured. Each stage call
+//  costs two counter reads, so probed runs are much slower than plain ones.
+//
+class stage_perf_counters_t : public stage_probe_t
+{
+public:
+    stage_perf_counters_t();
+    ~stage_perf_counters_t();
+
+    // Opens and starts the counters for the calling thread; false if none could be opened
+    bool open();
+
+    void begin_stage(proc_stage_t stage);
+    void end_stage(proc_stage_t stage);
+
+    // Writes one line per stage with its time and counter totals
+    void report(FILE* report_file) const;
+
+private:
+    stage_perf_counters_t(const stage_perf_counters_t&);
+    stage_perf_counters_t& operator=(const stage_perf_counters_t&);
+
+    void read_counters(uint64_t values[HOST_COUNTER_COUNT]);
+
+    int counter_fd[HOST_COUNTER_COUNT];        // -1 if the counter is unavailable
+    int group_position[HOST_COUNTER_COUNT];    // Position of the counter in a group read
+    int group_leader_fd;
+    int open_counter_count;
+    std::string unavailable_reason;             // Error from the first counter that failed to open
+    bool multiplexed;                           // The kernel time-shared the counters with other users
+
+    uint64_t stage_start_ns;
+    uint64_t stage_start_values[HOST_COUNTER_COUNT];
+    uint64_t stage_calls[PROC_STAGE_COUNT];
+    uint64_t stage_ns[PROC_STAGE_COUNT];
+    uint64_t stage_counts[PROC_STAGE_COUNT][HOST_COUNTER_COUNT];
+};
+
+#endif /* PROCSIM_PERF_HPP */
@@ -0,0 +1,139 @@
+#include "procsim_prefetch.hpp"
+#include <chrono>
+
+// Instructions the reader may run ahead of the fetch stage; a power of two
+#define PREFETCH_RING_CAPACITY 4096
+
+// How long the reader sleeps when the ring is full, in microseconds
+#define PREFETCH_FULL_SLEEP_US 20
+
+prefetching_trace_source::prefetching_trace_source(instruction_source* source)
+    : wrapped_source(source), ring(PREFETCH_RING_CAPACITY), ring_mask(PREFETCH_RING_CAPACITY - 1),
+      published_count(0), consumed_count(0), producer_finished(false), stop_requested(false), end_position(0),
+      consumer_index(0), consumer_published_limit(0)
+{
+    uint64_t position;
+    positions_supported = wrapped_source->tell(&position);
+    start();
+}
+
+void prefetching_trace_source::start()
+{
+    published_count.store(0, std::memory_order_relaxed);
+    consumed_count.store(0, std::memory_order_relaxed);
+    producer_finished.store(false, std::memory_order_relaxed);
+    stop_requested.store(false, std::memory_order_relaxed);
+    consumer_index = 0;
+    consumer_published_limit = 0;
+    producer_thread = std::thread(&prefetching_trace_source::produce, this);
+}
+
+void prefetching_trace_source::stop()
+{
+    if (!producer_thread.joinable()) return;
+    stop_requested.store(true, std::memory_order_relaxed);
+    producer_thread.join();
+}
+
+//
+// produce
+//
+//  Reader thread: fills the ring until the wrapped source ends or stop()
+//  is called, publishing its index every PREFETCH_PUBLISH_BATCH records
+//  and before it waits for space
+//
+void prefetching_trace_source::produce()
+{
+    uint64_t producer_index = 0;
+    uint64_t consumed_limit = 0;
+    proc_inst_t inst;
+
+    while (!stop_requested.load(std::memory_order_relaxed)) {
+        if (producer_index - consumed_limit == ring.size()) {
+            published_count.store(producer_index, std::memory_order_release);
+            consumed_limit = consumed_count.load(std::memory_order_acquire);
+            if (producer_index - consumed_limit == ring.size()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(PREFETCH_FULL_SLEEP_US));
+            }
+            continue;
+        }
+
+        prefetched_instruction_t& entry = ring[producer_index & ring_mask];
+        if (positions_supported && !wrapped_source->tell(&entry.position)) {
+            entry.position = 0;
+        }
+        if (!wrapped_source->read(&inst)) {
+            end_position = entry.position;
+            break;
+        }
+        entry.instruction_address = inst.instruction_address;
+        entry.op_code = inst.op_code;
+        entry.src_reg[0] = inst.src_reg[0];
+        entry.src_reg[1] = inst.src_reg[1];
+        entry.dest_reg = inst.dest_reg;
+
+        producer_index++;
+        if ((producer_index & (PREFETCH_PUBLISH_BATCH - 1)) == 0) {
+            published_count.store(producer_index, std::memory_order_release);
+        }
+    }
+
+    published_count.store(producer_index, std::memory_order_release);
+    producer_finished.store(true, std::memory_order_release);
+}
+
+//
+// wait_for_instruction
+//
+//  Consumer side: refreshes the published limit, spinning while the reader
+//  is behind. Returns false once the reader has finished and every record
+//  it produced has been consumed.
+//
+bool prefetching_trace_source::wait_for_instruction()
+{
+    for (;;) {
+        consumer_published_limit = published_count.load(std::memory_order_acquire);
+        if (consumer_index != consumer_published_limit) return true;
+        if (producer_finished.load(std::memory_order_acquire)) {
+            // The final publish precedes the finished flag, so one more load sees it
+            consumer_published_limit = published_count.load(std::memory_order_acquire);
+            return consumer_index != consumer_published_limit;
+        }
+        std::this_thread::yield();
+    }
+}
+
+bool prefetching_trace_source::tell(uint64_t* p_position)
+{
+    if (!positions_supported) return false;
+    *p_position = wait_for_instruction() ? ring[consumer_index & ring_mask].position : end_position;
+    return true;
+}
+
+bool prefetching_trace_source::seek(uint64_t position)
+{
+    if (!positions_supported) return false;
+
+    // Positions rise through the ring, so a target already read ahead is found by bisection
+    consumer_published_limit = published_count.load(std::memory_order_acquire);
+    uint64_t first_index = consumer_index;
+    uint64_t last_index = consumer_published_limit;
+    while (first_index < last_index) {
+        uint64_t middle_index = first_index + (last_index - first_index) / 2;
+        if (ring[middle_index & ring_mask].position < position) {
+            first_index = middle_index + 1;
+        } else {
+            last_index = middle_index;
+        }
+    }
+    if (first_index < consumer_published_limit && ring[first_index & ring_mask].position == position) {
+        consumer_index = first_index;
+        consumed_count.store(consumer_index, std::memory_order_release);
+        return true;
+    }
+
+    stop();
+    bool seek_ok = wrapped_source->seek(position);
+    start();
+    return seek_ok;
+}
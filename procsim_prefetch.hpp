@@ -0,0 +1,92 @@
+#ifndef PROCSIM_PREFETCH_HPP
+#define PROCSIM_PREFETCH_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "procsim.hpp"
+
+// Trace fields of one prefetched instruction and the source position it was read from
+typedef struct _prefetched_instruction_t
+{
+    uint32_t instruction_address;
+    int32_t op_code;
+    int32_t src_reg[2];
+    int32_t dest_reg;
+    uint64_t position;
+} prefetched_instruction_t;
+
+//
+// prefetching_trace_source
+//
+//  Wraps another source with a reader thread that parses or decodes
+//  instructions ahead of the fetch stage into a single-producer,
+//  single-consumer ring, so trace I/O overlaps simulation on a second
+//  core. Both sides publish their ring index once per batch; neither ever
+//  takes a lock. tell/seek work when the wrapped source supports them: a
+//  seek to a record already in the ring just skips ahead to it, any other
+//  seek stops the reader, repositions the source and restarts it.
+//
+class prefetching_trace_source : public instruction_source
+{
+public:
+    explicit prefetching_trace_source(instruction_source* source);
+    ~prefetching_trace_source() { stop(); }
+
+    bool read(proc_inst_t* p_inst)
+    {
+        if (consumer_index == consumer_published_limit && !wait_for_instruction()) return false;
+
+        const prefetched_instruction_t& entry = ring[consumer_index & ring_mask];
+        p_inst->instruction_address = entry.instruction_address;
+        p_inst->op_code = entry.op_code;
+        p_inst->src_reg[0] = entry.src_reg[0];
+        p_inst->src_reg[1] = entry.src_reg[1];
+        p_inst->dest_reg = entry.dest_reg;
+        consumer_index++;
+        if ((consumer_index & (PREFETCH_PUBLISH_BATCH - 1)) == 0) {
+            consumed_count.store(consumer_index, std::memory_order_release);
+        }
+        return true;
+    }
+
+    bool tell(uint64_t* p_position);
+    bool seek(uint64_t position);
+
+    // Stops the reader thread so the wrapped source may be inspected; only seek() may follow
+    void stop();
+
+private:
+    prefetching_trace_source(const prefetching_trace_source&);
+    prefetching_trace_source& operator=(const prefetching_trace_source&);
+
+    // Instructions each side handles between publishing its index
+    static const uint64_t PREFETCH_PUBLISH_BATCH = 64;
+
+    void start();
+    void produce();
+    bool wait_for_instruction();
+
+    instruction_source* wrapped_source;
+    bool positions_supported;
+
+    std::vector<prefetched_instruction_t> ring;
+    uint64_t ring_mask;
+
+    // Shared indices on separate cache lines so the two threads do not false-share
+    alignas(64) std::atomic<uint64_t> published_count;
+    alignas(64) std::atomic<uint64_t> consumed_count;
+    alignas(64) std::atomic<bool> producer_finished;
+    std::atomic<bool> stop_requested;
+    uint64_t end_position;   // Source position after the last instruction, valid once the producer finishes
+
+    // Consumer side
+    alignas(64) uint64_t consumer_index;
+    uint64_t consumer_published_limit;
+
+    std::thread producer_thread;
+};
+
+#endif /* PROCSIM_PREFETCH_HPP */
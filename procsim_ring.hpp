@@ -0,0 +1,84 @@
+#ifndef PROCSIM_RING_HPP
+#define PROCSIM_RING_HPP
+
+#include <cstddef>
+#include <vector>
+
+//
+// ring_buffer_t
+//
+//  FIFO over a preallocated power-of-two array. Popping from the front only
+//  moves the head index, so draining a batch never shifts the remaining
+//  elements. The array doubles if a push finds it full.
+//
+template <typename element_t>
+class ring_buffer_t
+{
+public:
+    ring_buffer_t() : head_index(0), element_count(0), index_mask(0) {}
+
+    void reset(size_t minimum_capacity)
+    {
+        size_t slot_count = 1;
+        while (slot_count < minimum_capacity) slot_count <<= 1;
+        slots.assign(slot_count, element_t());
+        head_index = 0;
+        element_count = 0;
+        index_mask = slot_count - 1;
+    }
+
+    size_t size() const { return element_count; }
+    bool empty() const { return element_count == 0; }
+
+    element_t& operator[](size_t position) { return slots[(head_index + position) & index_mask]; }
+    const element_t& operator[](size_t position) const { return slots[(head_index + position) & index_mask]; }
+    element_t& front() { return slots[head_index]; }
+
+    // Appends an element and returns it for the caller to fill in place
+    element_t& push_back()
+    {
+        if (element_count == slots.size()) grow();
+        element_t& slot = slots[(head_index + element_count) & index_mask];
+        element_count++;
+        return slot;
+    }
+
+    void push_back(const element_t& element) { push_back() = element; }
+
+    void pop_front(size_t pop_count)
+    {
+        head_index = (head_index + pop_count) & index_mask;
+        element_count -= pop_count;
+    }
+
+    void pop_back()
+    {
+        element_count--;
+    }
+
+    void clear()
+    {
+        head_index = 0;
+        element_count = 0;
+    }
+
+private:
+    void grow()
+    {
+        size_t slot_count = slots.empty() ? 1 : slots.size() * 2;
+        std::vector<element_t> new_slots(slot_count);
+        for (size_t position = 0; position < element_count; position++) {
+            new_slots[position] = (*this)[position];
+        }
+        slots.swap(new_slots);
+        head_index = 0;
+        index_mask = slot_count - 1;
+    }
+
+    std::vector<element_t> slots;
+    size_t head_index;
+    size_t element_count;
+    size_t index_mask;
+};
+
+#endif /* PROCSIM_RING_HPP */
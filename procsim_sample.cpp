@@ -0,0 +1,120 @@
+#include "procsim_sample.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+bool simulate_retirement_points(const trace_record_t* first_record, uint64_t record_count, const proc_config_t& config,
+                                retirement_point_t* points, size_t point_count, proc_stats_t* p_stats)
+{
+    memory_trace_source source(first_record, record_count);
+    proc_sim_t simulator(config, &source);
+    proc_stats_t stats;
+    memset(&stats, 0, sizeof(proc_stats_t));
+
+    for (size_t point_index = 0; point_index < point_count; point_index++) {
+        retirement_point_t& point = points[point_index];
+        if (point.retired_count == 0) {
+            point.cycle = 1;
+            point.fired_instructions = 0;
+            continue;
+        }
+        simulator.run_until_retired(&stats, point.retired_count);
+        if (simulator.retired_instruction_count() < point.retired_count) return false;
+        point.cycle = simulator.simulated_cycle_count();
+        point.fired_instructions = simulator.fired_instruction_count();
+    }
+    if (p_stats != NULL) {
+        simulator.complete(&stats);
+        *p_stats = stats;
+    }
+    return true;
+}
+
+// Two-sided normal quantile for the supported confidence levels
+static double normal_quantile(double confidence_level)
+{
+    if (confidence_level >= 0.99) return 2.576;
+    if (confidence_level >= 0.95) return 1.960;
+    return 1.645;
+}
+
+bool run_sampled_simulation(const trace_record_t* trace_records, uint64_t trace_length,
+                            const proc_config_t& config, const sampling_config_t& sampling,
+                            unsigned thread_count, sampling_result_t* p_result)
+{
+    memset(p_result, 0, sizeof(sampling_result_t));
+
+    // Each unit runs with warmup_length instructions before it and as many after it
+    uint64_t slice_length = sampling.warmup_length + sampling.unit_length + sampling.warmup_length;
+    if (sampling.sample_count < 2 || sampling.unit_length == 0 || sampling.sample_count * slice_length > trace_length) {
+        fprintf(stderr, "Trace of %lu instructions is too short for %lu samples of %lu instructions\n",
+                (unsigned long)trace_length, (unsigned long)sampling.sample_count, (unsigned long)slice_length);
+        return false;
+    }
+
+    // Systematic sampling: unit i measures the slice starting at i * period
+    uint64_t sample_period = trace_length / sampling.sample_count;
+    std::vector<double> unit_cpi(sampling.sample_count);
+    std::atomic<bool> all_finished(true);
+
+    if (thread_count == 0) {
+        thread_count = std::thread::hardware_concurrency();
+        if (thread_count == 0) thread_count = 1;
+    }
+    if (thread_count > sampling.sample_count) thread_count = sampling.sample_count;
+
+    std::atomic<size_t> next_sample_index(0);
+    auto worker = [&]() {
+        size_t sample_index;
+        while ((sample_index = next_sample_index.fetch_add(1)) < sampling.sample_count) {
+            retirement_point_t points[2];
+            points[0].retired_count = sampling.warmup_length;
+            points[1].retired_count = sampling.warmup_length + sampling.unit_length;
+            if (!simulate_retirement_points(trace_records + sample_index * sample_period, slice_length, config, points, 2, NULL)) {
+                all_finished = false;
+            }
+            unit_cpi[sample_index] = (double)(points[1].cycle - points[0].cycle) / (double)sampling.unit_length;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned thread_index = 1; thread_index < thread_count; thread_index++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& worker_thread : workers) {
+        worker_thread.join();
+    }
+
+    if (!all_finished) {
+        fprintf(stderr, "A sampled unit tripped the watchdog; the configuration cannot drain the trace\n");
+        return false;
+    }
+
+    double cpi_sum = 0;
+    for (double cpi : unit_cpi) cpi_sum += cpi;
+    double mean_cpi = cpi_sum / (double)sampling.sample_count;
+
+    double squared_deviation_sum = 0;
+    for (double cpi : unit_cpi) squared_deviation_sum += (cpi - mean_cpi) * (cpi - mean_cpi);
+    double cpi_standard_deviation = std::sqrt(squared_deviation_sum / (double)(sampling.sample_count - 1));
+
+    // Confidence interval of the mean CPI, scaled to the whole trace
+    double cpi_half_width = normal_quantile(sampling.confidence_level) * cpi_standard_deviation / std::sqrt((double)sampling.sample_count);
+
+    p_result->sample_count = sampling.sample_count;
+    p_result->detailed_instruction_count = sampling.sample_count * slice_length;
+    p_result->mean_cpi = mean_cpi;
+    p_result->cpi_standard_deviation = cpi_standard_deviation;
+    p_result->estimated_cycles = mean_cpi * (double)trace_length;
+    p_result->estimated_cycles_low = std::max(0.0, mean_cpi - cpi_half_width) * (double)trace_length;
+    p_result->estimated_cycles_high = (mean_cpi + cpi_half_width) * (double)trace_length;
+    p_result->estimated_ipc = mean_cpi > 0 ? 1.0 / mean_cpi : 0;
+    p_result->estimated_ipc_low = p_result->estimated_cycles_high > 0 ? (double)trace_length / p_result->estimated_cycles_high : 0;
+    p_result->estimated_ipc_high = p_result->estimated_cycles_low > 0 ? (double)trace_length / p_result->estimated_cycles_low : 0;
+    return true;
+}
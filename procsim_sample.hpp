@@ -0,0 +1,73 @@
+#ifndef PROCSIM_SAMPLE_HPP
+#define PROCSIM_SAMPLE_HPP
+
+#include <cstdint>
+
+#include "procsim.hpp"
+#include "procsim_trace.hpp"
+
+// Sampling plan for run_sampled_simulation
+typedef struct _sampling_config_t
+{
+    uint64_t sample_count;      // Measurement units spread evenly over the trace
+    uint64_t unit_length;       // Instructions measured in each unit
+    uint64_t warmup_length;     // Instructions simulated in detail before each unit to fill the pipeline
+    double confidence_level;    // 0.90, 0.95 or 0.99
+} sampling_config_t;
+
+typedef struct _sampling_result_t
+{
+    uint64_t sample_count;
+    uint64_t detailed_instruction_count;   // Instructions simulated in detail, warm-up included
+    double mean_cpi;
+    double cpi_standard_deviation;
+    double estimated_cycles;               // Comparable to the cycle count printed for a full run
+    double estimated_cycles_low;
+    double estimated_cycles_high;
+    double estimated_ipc;
+    double estimated_ipc_low;
+    double estimated_ipc_high;
+} sampling_result_t;
+
+// Cycle in which the oldest retired_count instructions of a simulation had all retired
+typedef struct _retirement_point_t
+{
+    uint64_t retired_count;
+    uint64_t cycle;                // 1 for retired_count 0, matching the run_proc convention
+    uint64_t fired_instructions;   // Instructions fired by the end of that cycle
+} retirement_point_t;
+
+//
+// simulate_retirement_points
+//
+//  Simulates record_count records from first_record in detail, stopping
+//  once the last point is reached, and fills in the cycle of every point
+//  (sorted by retired_count). Instructions after a point keep competing for
+//  resources while it is measured, so the difference between two points
+//  charges the instructions between them what they cost in the middle of a
+//  longer run. p_stats, if not NULL, receives the statistics of the run up
+//  to the last point. Returns false if a point is never reached.
+//
+bool simulate_retirement_points(const trace_record_t* first_record, uint64_t record_count, const proc_config_t& config,
+                                retirement_point_t* points, size_t point_count, proc_stats_t* p_stats);
+
+//
+// run_sampled_simulation
+//
+//  Estimates the cycle count of the whole trace from sample_count short
+//  detailed simulations spread evenly across it. Everything between units
+//  is fast-forwarded by skipping records. Every instruction skipped has
+//  completed by the time the next unit starts, so the warm rename state at
+//  a unit boundary is a table with every value available; each unit's own
+//  warm-up then rebuilds the in-flight reservation station, rename and
+//  dispatch state. A unit is charged the cycles between the retirement of
+//  its warm-up and its own retirement, with warmup_length more instructions
+//  following it. Units run on thread_count worker threads (0 selects one per
+//  hardware thread). Returns false if the trace is too short for the plan
+//  or a unit trips the watchdog.
+//
+bool run_sampled_simulation(const trace_record_t* trace_records, uint64_t trace_length,
+                            const proc_config_t& config, const sampling_config_t& sampling,
+                            unsigned thread_count, sampling_result_t* p_result);
+
+#endif /* PROCSIM_SAMPLE_HPP */
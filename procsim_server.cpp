@@ -0,0 +1,588 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cctype>
+#include <climits>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <queue>
+#include <set>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "procsim.hpp"
+#include "procsim_ctrace.hpp"
+#include "procsim_sweep.hpp"
+#include "procsim_trace.hpp"
+
+//
+// procsim_server
+//
+//  Long-running simulation service on a Unix domain socket. Decoded traces
+//  stay resident between queries and configurations run on a fixed pool
+//  of worker threads, so a query costs only its simulation time.
+//
+//  Each request is one line: a trace path followed by driver-style options,
+//
+//      traces/gcc.trace -r 1,2,4 -f 8 [-j k0] [-k k1] [-l k2] [-a regs] [-L l0,l1,l2] [-W cycles]
+//
+//  where list options expand to every combination as in a procsim sweep.
+//  The reply is "ok <count>" and one tab-separated line per configuration,
+//
+//      R k0 k1 k2 F L cycles retired avg_inst_fired avg_inst_retired avg_disp_size max_disp_size
+//
+//  with L the FU latencies in -L form (e.g. "1,3p,5"),
+//  "watchdog" in place of cycles for a configuration that could not
+//  drain the trace, or a single "error <message>" line. A connection may
+//  send any number of requests; replies come back in request order.
+//
+
+// Longest request line accepted
+#define SERVER_MAX_REQUEST_LENGTH 4096
+
+// Configurations a single request may expand to
+#define SERVER_MAX_REQUEST_CONFIGS 4096
+
+// Most worker threads -t accepts
+#define SERVER_MAX_WORKER_THREADS 1024
+
+// Most resident traces -m accepts
+#define SERVER_MAX_RESIDENT_TRACES 4096
+
+// How often the accept loop checks for a shutdown signal, in milliseconds
+#define SERVER_POLL_INTERVAL_MS 200
+
+static volatile sig_atomic_t shutdown_requested = 0;
+
+static void request_shutdown(int)
+{
+    shutdown_requested = 1;
+}
+
+//
+// cached_trace_t
+//
+//  One resident trace. Binary traces stay mapped; text and compressed
+//  traces are decoded into records once. The file identity detects a trace
+//  rewritten since it was loaded.
+//
+typedef struct _cached_trace_t
+{
+    std::string path;
+    dev_t device;
+    ino_t inode;
+    off_t file_size;
+    struct timespec modified_time;
+
+    std::once_flag load_once;
+    bool loaded;
+    mapped_trace_t mapped_trace;
+    std::vector<trace_record_t> decoded_records;
+    const trace_record_t* records;
+    uint64_t record_count;
+} cached_trace_t;
+
+//
+// trace_cache_t
+//
+//  Resident traces by canonical path, least recently used first out once
+//  more than capacity are cached. Queries hold a shared_ptr, so an evicted
+//  or replaced trace stays valid until its last simulation ends.
+//
+class trace_cache_t
+{
+public:
+    explicit trace_cache_t(size_t capacity) : cache_capacity(capacity) {}
+
+    // Returns the resident trace for path, loading it on first use; NULL with error set on failure
+    std::shared_ptr<cached_trace_t> acquire(const char* path, std::string* p_error)
+    {
+        char canonical_path[PATH_MAX];
+        struct stat file_status;
+        if (realpath(path, canonical_path) == NULL || stat(canonical_path, &file_status) != 0) {
+            *p_error = std::string("cannot open ") + path + ": " + strerror(errno);
+            return NULL;
+        }
+
+        std::shared_ptr<cached_trace_t> trace;
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            for (auto entry = resident_traces.begin(); entry != resident_traces.end(); ++entry) {
+                if ((*entry)->path != canonical_path) continue;
+                if (same_file_version(**entry, file_status)) {
+                    trace = *entry;
+                    resident_traces.splice(resident_traces.end(), resident_traces, entry);
+                } else {
+                    resident_traces.erase(entry);
+                }
+                break;
+            }
+            if (!trace) {
+                trace = std::make_shared<cached_trace_t>();
+                trace->path = canonical_path;
+                trace->device = file_status.st_dev;
+                trace->inode = file_status.st_ino;
+                trace->file_size = file_status.st_size;
+                trace->modified_time = file_status.st_mtim;
+                trace->loaded = false;
+                resident_traces.push_back(trace);
+                while (resident_traces.size() > cache_capacity) resident_traces.pop_front();
+            }
+        }
+
+        // Concurrent first queries for a trace wait here for a single load, other traces are unaffected
+        std::call_once(trace->load_once, [&]() { trace->loaded = load_trace(trace.get()); });
+        if (!trace->loaded) {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            resident_traces.remove(trace);
+            *p_error = std::string("cannot load trace ") + path;
+            return NULL;
+        }
+        return trace;
+    }
+
+private:
+    static bool same_file_version(const cached_trace_t& trace, const struct stat& file_status)
+    {
+        return trace.device == file_status.st_dev && trace.inode == file_status.st_ino &&
+               trace.file_size == file_status.st_size &&
+               trace.modified_time.tv_sec == file_status.st_mtim.tv_sec &&
+               trace.modified_time.tv_nsec == file_status.st_mtim.tv_nsec;
+    }
+
+    static bool load_trace(cached_trace_t* p_trace)
+    {
+        const char* path = p_trace->path.c_str();
+        if (is_binary_trace_file(path)) {
+            if (!p_trace->mapped_trace.open(path)) return false;
+            p_trace->records = p_trace->mapped_trace.records();
+            p_trace->record_count = p_trace->mapped_trace.size();
+            return true;
+        }
+
+        bool loaded;
+        if (is_compressed_trace_file(path)) {
+            loaded = load_compressed_trace(path, p_trace->decoded_records);
+        } else {
+            FILE* trace_file = fopen(path, "r");
+            if (trace_file == NULL) return false;
+            loaded = load_text_trace(trace_file, p_trace->decoded_records);
+            fclose(trace_file);
+        }
+        p_trace->records = p_trace->decoded_records.data();
+        p_trace->record_count = p_trace->decoded_records.size();
+        return loaded;
+    }
+
+    size_t cache_capacity;
+    std::mutex cache_mutex;
+    std::list<std::shared_ptr<cached_trace_t> > resident_traces;
+};
+
+//
+// worker_pool_t
+//
+//  Fixed set of threads running queued simulations in submission order
+//
+class worker_pool_t
+{
+public:
+    explicit worker_pool_t(unsigned thread_count) : stopping(false)
+    {
+        for (unsigned thread_index = 0; thread_index < thread_count; thread_index++) {
+            workers.emplace_back([this]() { run_jobs(); });
+        }
+    }
+
+    ~worker_pool_t()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        queue_ready.notify_all();
+        for (std::thread& worker_thread : workers) {
+            worker_thread.join();
+        }
+    }
+
+    std::future<sweep_result_t> submit(std::function<sweep_result_t()> job)
+    {
+        std::shared_ptr<std::packaged_task<sweep_result_t()> > task =
+            std::make_shared<std::packaged_task<sweep_result_t()> >(job);
+        std::future<sweep_result_t> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            pending_jobs.push([task]() { (*task)(); });
+        }
+        queue_ready.notify_one();
+        return result;
+    }
+
+private:
+    void run_jobs()
+    {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_ready.wait(lock, [this]() { return stopping || !pending_jobs.empty(); });
+                if (pending_jobs.empty()) return;
+                job = std::move(pending_jobs.front());
+                pending_jobs.pop();
+            }
+            job();
+        }
+    }
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_ready;
+    std::queue<std::function<void()> > pending_jobs;
+    bool stopping;
+    std::vector<std::thread> workers;
+};
+
+// Simulates one configuration over a resident trace
+static sweep_result_t simulate_resident_trace(std::shared_ptr<cached_trace_t> trace, proc_config_t config)
+{
+    memory_trace_source source(trace->records, trace->record_count);
+    proc_sim_t simulator(config, &source);
+
+    sweep_result_t result;
+    memset(&result.stats, 0, sizeof(proc_stats_t));
+    simulator.run(&result.stats);
+    simulator.complete(&result.stats);
+    result.watchdog_expired = simulator.watchdog_expired();
+    return result;
+}
+
+// Parses the decimal number at cursor, returns false unless it is in minimum..maximum
+static bool parse_bounded_value(const char* cursor, char** p_value_end, uint64_t minimum, uint64_t maximum, uint64_t* p_value)
+{
+    if (!isdigit((unsigned char)*cursor)) return false;
+    errno = 0;
+    *p_value = strtoull(cursor, p_value_end, 10);
+    return errno == 0 && *p_value >= minimum && *p_value <= maximum;
+}
+
+// Parses a comma separated value list such as "1,2,4", returns false if malformed or a value is outside 1..maximum
+static bool parse_value_list(const char* argument, uint64_t maximum, std::vector<uint64_t>& values)
+{
+    values.clear();
+    const char* cursor = argument;
+    while (*cursor != '\0') {
+        char* value_end;
+        uint64_t value;
+        if (!parse_bounded_value(cursor, &value_end, 1, maximum, &value)) return false;
+        if (*value_end != ',' && *value_end != '\0') return false;
+        values.push_back(value);
+        cursor = (*value_end == ',') ? value_end + 1 : value_end;
+    }
+    return !values.empty();
+}
+
+// Parses a single number in minimum..maximum, returns false if malformed or out of range
+static bool parse_single_value(const char* argument, uint64_t minimum, uint64_t maximum, uint64_t* p_value)
+{
+    char* value_end;
+    return parse_bounded_value(argument, &value_end, minimum, maximum, p_value) && *value_end == '\0';
+}
+
+// Reply for an option value outside its range
+static std::string range_error(const char* option, uint64_t minimum, uint64_t maximum)
+{
+    return std::string("error ") + option + " must be between " + std::to_string(minimum) + " and " +
+           std::to_string(maximum) + "\n";
+}
+
+//
+// serve_request
+//
+//  Runs one request line and returns the complete reply
+//
+static std::string serve_request(char* request, trace_cache_t& trace_cache, worker_pool_t& pool)
+{
+    std::vector<char*> words;
+    char* word_cursor;
+    for (char* word = strtok_r(request, " \t\r", &word_cursor); word != NULL; word = strtok_r(NULL, " \t\r", &word_cursor)) {
+        words.push_back(word);
+    }
+    if (words.empty()) return "error empty request\n";
+
+    std::vector<uint64_t> f(1, DEFAULT_F);
+    std::vector<uint64_t> k0(1, DEFAULT_K0);
+    std::vector<uint64_t> k1(1, DEFAULT_K1);
+    std::vector<uint64_t> k2(1, DEFAULT_K2);
+    std::vector<uint64_t> r(1, DEFAULT_R);
+    uint64_t architectural_registers = DEFAULT_ARCH_REGS;
+    uint64_t watchdog_cycles = DEFAULT_WATCHDOG_CYCLES;
+    uint64_t fu_latency[3] = { DEFAULT_FU_LATENCY, DEFAULT_FU_LATENCY, DEFAULT_FU_LATENCY };
+    bool fu_pipelined[3] = { false, false, false };
+    for (size_t word_index = 1; word_index < words.size(); word_index += 2) {
+        const char* option = words[word_index];
+        if (word_index + 1 == words.size() || option[0] != '-' || option[1] == '\0' || option[2] != '\0') {
+            return std::string("error bad option ") + option + "\n";
+        }
+        const char* argument = words[word_index + 1];
+        std::vector<uint64_t>* p_values = NULL;
+        switch (option[1]) {
+        case 'r': p_values = &r; break;
+        case 'j': p_values = &k0; break;
+        case 'k': p_values = &k1; break;
+        case 'l': p_values = &k2; break;
+        case 'f': p_values = &f; break;
+        case 'a':
+            if (!parse_single_value(argument, 1, MAX_ARCH_REGS, &architectural_registers)) {
+                return range_error(option, 1, MAX_ARCH_REGS);
+            }
+            break;
+        case 'W':
+            if (!parse_single_value(argument, 1, UINT64_MAX, &watchdog_cycles)) {
+                return std::string("error ") + option + " must be a positive cycle count\n";
+            }
+            break;
+        case 'L':
+            if (!parse_fu_latency_list(argument, fu_latency, fu_pipelined)) {
+                return std::string("error bad latency list ") + argument + "\n";
+            }
+            break;
+        default:
+            return std::string("error bad option ") + option + "\n";
+        }
+        if (p_values != NULL && !parse_value_list(argument, MAX_PIPELINE_WIDTH, *p_values)) {
+            return std::string("error bad value list ") + argument + " (values must be between 1 and " +
+                   std::to_string(MAX_PIPELINE_WIDTH) + ")\n";
+        }
+    }
+    if (r.size() * k0.size() * k1.size() * k2.size() * f.size() > SERVER_MAX_REQUEST_CONFIGS) {
+        return "error too many configurations\n";
+    }
+
+    std::string load_error;
+    std::shared_ptr<cached_trace_t> trace = trace_cache.acquire(words[0], &load_error);
+    if (!trace) return "error " + load_error + "\n";
+
+    std::vector<proc_config_t> configs = build_config_grid(r, k0, k1, k2, f);
+    std::vector<std::future<sweep_result_t> > results;
+    for (proc_config_t& config : configs) {
+        config.architectural_registers = architectural_registers;
+        config.watchdog_cycles = watchdog_cycles;
+        std::copy(fu_latency, fu_latency + 3, config.fu_latency);
+        std::copy(fu_pipelined, fu_pipelined + 3, config.fu_pipelined);
+        results.push_back(pool.submit(std::bind(simulate_resident_trace, trace, config)));
+    }
+
+    std::string reply = "ok " + std::to_string(configs.size()) + "\n";
+    for (size_t config_index = 0; config_index < configs.size(); config_index++) {
+        // A simulation that throws (e.g. out of memory) fails this request, never the server
+        sweep_result_t result;
+        try {
+            result = results[config_index].get();
+        } catch (const std::exception& error) {
+            return std::string("error simulation failed: ") + error.what() + "\n";
+        }
+        const proc_config_t& config = configs[config_index];
+        char line[512];
+        char cycles[32];
+        if (result.watchdog_expired) {
+            snprintf(cycles, sizeof(cycles), "watchdog");
+        } else {
+            snprintf(cycles, sizeof(cycles), "%" PRIu64, result.stats.cycle_count - 1);
+        }
+        char latencies[64];
+        snprintf(latencies, sizeof(latencies), "%" PRIu64 "%s,%" PRIu64 "%s,%" PRIu64 "%s",
+                 config.fu_latency[0], config.fu_pipelined[0] ? "p" : "", config.fu_latency[1], config.fu_pipelined[1] ? "p" : "",
+                 config.fu_latency[2], config.fu_pipelined[2] ? "p" : "");
+        snprintf(line, sizeof(line), "%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64
+                 "\t%s\t%s\t%" PRIu64 "\t%f\t%f\t%f\t%" PRIu64 "\n",
+                 config.result_buses, config.fu_type0, config.fu_type1, config.fu_type2, config.fetch_width,
+                 latencies, cycles, result.stats.retired_instruction, result.stats.avg_inst_fired,
+                 result.stats.avg_inst_retired, result.stats.avg_disp_size, result.stats.max_disp_size);
+        reply += line;
+    }
+    return reply;
+}
+
+static bool write_all(int socket_fd, const std::string& data)
+{
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t count = send(socket_fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        written += count;
+    }
+    return true;
+}
+
+//
+// serve_connection
+//
+//  Answers the requests of one client in order until it disconnects; the
+//  caller closes the socket
+//
+static void serve_connection(int socket_fd, trace_cache_t& trace_cache, worker_pool_t& pool)
+{
+    std::string pending_input;
+    char buffer[4096];
+    bool connected = true;
+    while (connected) {
+        ssize_t count = recv(socket_fd, buffer, sizeof(buffer), 0);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;
+        pending_input.append(buffer, count);
+
+        // Lines are served only once complete and within the length limit
+        size_t line_end;
+        while (connected && (line_end = pending_input.find('\n')) != std::string::npos &&
+               line_end <= SERVER_MAX_REQUEST_LENGTH) {
+            std::string request = pending_input.substr(0, line_end);
+            pending_input.erase(0, line_end + 1);
+            std::string reply;
+            try {
+                reply = serve_request(&request[0], trace_cache, pool);
+            } catch (const std::exception& error) {
+                reply = std::string("error ") + error.what() + "\n";
+            }
+            connected = write_all(socket_fd, reply);
+        }
+        if (!connected) break;
+        size_t line_length = std::min(pending_input.find('\n'), pending_input.size());
+        if (line_length > SERVER_MAX_REQUEST_LENGTH) {
+            write_all(socket_fd, "error request too long\n");
+            break;
+        }
+    }
+}
+
+void print_help_and_exit(void) {
+    printf("procsim_server [OPTIONS] socket_path\n");
+    printf("  -t threads\tSimulation worker threads (default: all cores)\n");
+    printf("  -m traces\tTraces kept resident, least recently used evicted first (default 16)\n");
+    printf("  -h\t\tThis helpful output\n");
+    printf("Requests are lines of the form: trace_path [-r R] [-j k0] [-k k1] [-l k2] [-f F] [-a regs] [-L l0,l1,l2] [-W cycles]\n");
+    exit(0);
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    unsigned thread_count = 0;
+    size_t cache_capacity = 16;
+    uint64_t option_value;
+
+    while (-1 != (opt = getopt(argc, argv, "t:m:h"))) {
+        switch (opt) {
+        case 't':
+            if (!parse_single_value(optarg, 1, SERVER_MAX_WORKER_THREADS, &option_value)) {
+                fprintf(stderr, "-t must be between 1 and %d\n", SERVER_MAX_WORKER_THREADS);
+                return 1;
+            }
+            thread_count = (unsigned)option_value;
+            break;
+        case 'm':
+            if (!parse_single_value(optarg, 1, SERVER_MAX_RESIDENT_TRACES, &option_value)) {
+                fprintf(stderr, "-m must be between 1 and %d\n", SERVER_MAX_RESIDENT_TRACES);
+                return 1;
+            }
+            cache_capacity = (size_t)option_value;
+            break;
+        case 'h':
+        default:
+            print_help_and_exit();
+            break;
+        }
+    }
+    if (optind + 1 != argc) print_help_and_exit();
+    const char* socket_path = argv[optind];
+
+    if (thread_count == 0) {
+        thread_count = std::thread::hardware_concurrency();
+        if (thread_count == 0) thread_count = 1;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path %s is too long\n", socket_path);
+        return 1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    // A socket left behind by a server that did not shut down cleanly is replaced
+    struct stat socket_status;
+    if (lstat(socket_path, &socket_status) == 0 && S_ISSOCK(socket_status.st_mode)) {
+        unlink(socket_path);
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listen_fd, 64) != 0) {
+        fprintf(stderr, "Failed to listen on %s: %s\n", socket_path, strerror(errno));
+        return 1;
+    }
+
+    signal(SIGINT, request_shutdown);
+    signal(SIGTERM, request_shutdown);
+    signal(SIGPIPE, SIG_IGN);
+
+    trace_cache_t trace_cache(cache_capacity);
+    worker_pool_t pool(thread_count);
+    std::mutex connections_mutex;
+    std::set<int> open_connections;
+    fprintf(stderr, "procsim_server listening on %s with %u workers\n", socket_path, thread_count);
+
+    while (!shutdown_requested) {
+        struct pollfd listen_poll;
+        listen_poll.fd = listen_fd;
+        listen_poll.events = POLLIN;
+        if (poll(&listen_poll, 1, SERVER_POLL_INTERVAL_MS) <= 0) continue;
+
+        int connection_fd = accept(listen_fd, NULL, NULL);
+        if (connection_fd < 0) continue;
+
+        // Connection threads only parse and reply; the pool bounds how many simulations run at once
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            open_connections.insert(connection_fd);
+        }
+        std::thread([connection_fd, &trace_cache, &pool, &connections_mutex, &open_connections]() {
+            serve_connection(connection_fd, trace_cache, pool);
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            open_connections.erase(connection_fd);
+            close(connection_fd);
+        }).detach();
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+
+    // Stop reading from clients, but let requests in progress send their replies before the pool and cache go away
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        for (int connection_fd : open_connections) {
+            shutdown(connection_fd, SHUT_RD);
+        }
+    }
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            if (open_connections.empty()) break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return 0;
+}
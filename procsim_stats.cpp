@@ -0,0 +1,82 @@
+#include "procsim_stats.hpp"
+#include <algorithm>
+#include <cinttypes>
+
+void reset_stall_counters(stall_counters_t* p_counters, const proc_config_t& config)
+{
+    uint64_t total_functional_units = config.fu_type0 + config.fu_type1 + config.fu_type2;
+
+    p_counters->cycles = 0;
+    p_counters->result_bus_denied = 0;
+    p_counters->result_bus_denied_cycles = 0;
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        p_counters->functional_unit_denied[functional_unit_type_id] = 0;
+        p_counters->functional_unit_denied_cycles[functional_unit_type_id] = 0;
+    }
+    p_counters->reservation_station_full_stalls = 0;
+    p_counters->reservation_station_full_cycles = 0;
+    p_counters->operand_wait = 0;
+
+    p_counters->reservation_station_histogram.assign(2 * total_functional_units + 1, 0);
+    p_counters->dispatch_queue_histogram.assign(DISPATCH_QUEUE_HISTOGRAM_BUCKETS, 0);
+    // Results wait for a bus in their unit, unless the unit is pipelined and takes new work meanwhile
+    uint64_t most_waiting_results = total_functional_units;
+    if (config.fu_pipelined[0] || config.fu_pipelined[1] || config.fu_pipelined[2]) {
+        most_waiting_results = 2 * total_functional_units;
+    }
+    p_counters->result_buses_used_histogram.assign(std::min(config.result_buses, most_waiting_results) + 1, 0);
+    p_counters->fired_per_cycle_histogram.assign(total_functional_units + 1, 0);
+}
+
+static void write_json_array(FILE* json_file, const char* name, const uint64_t* values, size_t count)
+{
+    fprintf(json_file, "\"%s\":[", name);
+    for (size_t index = 0; index < count; index++) {
+        fprintf(json_file, "%s%" PRIu64, index == 0 ? "" : ",", values[index]);
+    }
+    fprintf(json_file, "]");
+}
+
+bool write_stats_json(FILE* json_file, const proc_config_t& config, const proc_stats_t& stats,
+                      const stall_counters_t& counters)
+{
+    fprintf(json_file, "{\"config\":{\"R\":%" PRIu64 ",\"k0\":%" PRIu64 ",\"k1\":%" PRIu64 ",\"k2\":%" PRIu64
+            ",\"F\":%" PRIu64 ",\"architectural_registers\":%" PRIu64 ",",
+            config.result_buses, config.fu_type0, config.fu_type1, config.fu_type2, config.fetch_width,
+            config.architectural_registers);
+    write_json_array(json_file, "fu_latency", config.fu_latency, 3);
+    fprintf(json_file, ",\"fu_pipelined\":[%s,%s,%s]},\n", config.fu_pipelined[0] ? "true" : "false",
+            config.fu_pipelined[1] ? "true" : "false", config.fu_pipelined[2] ? "true" : "false");
+    fprintf(json_file, " \"stats\":{\"cycles\":%" PRIu64 ",\"retired_instructions\":%" PRIu64 ",\"avg_inst_retired\":%f,"
+            "\"avg_inst_fired\":%f,\"avg_disp_size\":%f,\"max_disp_size\":%" PRIu64 "},\n",
+            stats.cycle_count - 1, stats.retired_instruction, stats.avg_inst_retired,
+            stats.avg_inst_fired, stats.avg_disp_size, stats.max_disp_size);
+
+    fprintf(json_file, " \"stalls\":{\"sampled_cycles\":%" PRIu64 ",\"result_bus_denied\":%" PRIu64
+            ",\"result_bus_denied_cycles\":%" PRIu64 ",",
+            counters.cycles, counters.result_bus_denied, counters.result_bus_denied_cycles);
+    write_json_array(json_file, "functional_unit_denied", counters.functional_unit_denied, 3);
+    fprintf(json_file, ",");
+    write_json_array(json_file, "functional_unit_denied_cycles", counters.functional_unit_denied_cycles, 3);
+    fprintf(json_file, ",\"reservation_station_full_stalls\":%" PRIu64 ",\"reservation_station_full_cycles\":%" PRIu64
+            ",\"operand_wait\":%" PRIu64 "},\n",
+            counters.reservation_station_full_stalls, counters.reservation_station_full_cycles, counters.operand_wait);
+
+    fprintf(json_file, " \"histograms\":{");
+    write_json_array(json_file, "reservation_station_occupancy",
+                     counters.reservation_station_histogram.data(), counters.reservation_station_histogram.size());
+    fprintf(json_file, ",");
+    // Trailing empty power-of-two buckets are dropped
+    size_t dispatch_bucket_count = counters.dispatch_queue_histogram.size();
+    while (dispatch_bucket_count > 1 && counters.dispatch_queue_histogram[dispatch_bucket_count - 1] == 0) dispatch_bucket_count--;
+    write_json_array(json_file, "dispatch_queue_log2_occupancy", counters.dispatch_queue_histogram.data(), dispatch_bucket_count);
+    fprintf(json_file, ",");
+    write_json_array(json_file, "result_buses_used",
+                     counters.result_buses_used_histogram.data(), counters.result_buses_used_histogram.size());
+    fprintf(json_file, ",");
+    write_json_array(json_file, "fired_per_cycle",
+                     counters.fired_per_cycle_histogram.data(), counters.fired_per_cycle_histogram.size());
+    fprintf(json_file, "}}\n");
+
+    return !ferror(json_file);
+}
@@ -0,0 +1,25 @@
+#ifndef PROCSIM_STATS_HPP
+#define PROCSIM_STATS_HPP
+
+#include <cstdint>
+#include <cstdio>
+
+#include "procsim.hpp"
+
+// Dispatch queue histogram buckets: empty, then [2^(b-1), 2^b) for bucket b
+#define DISPATCH_QUEUE_HISTOGRAM_BUCKETS 65
+
+// Zeroes the counters and sizes the histograms for a configuration
+void reset_stall_counters(stall_counters_t* p_counters, const proc_config_t& config);
+
+// Histogram bucket of a dispatch queue size
+inline size_t dispatch_queue_histogram_bucket(uint64_t queue_size)
+{
+    return queue_size == 0 ? 0 : 64 - __builtin_clzll(queue_size);
+}
+
+// Writes the configuration, final statistics and stall counters as one JSON object
+bool write_stats_json(FILE* json_file, const proc_config_t& config, const proc_stats_t& stats,
+                      const stall_counters_t& counters);
+
+#endif /* PROCSIM_STATS_HPP */
@@ -0,0 +1,257 @@
+#include "procsim_sweep.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <thread>
+
+// Trace records a lockstep slice lets every configuration fetch beyond the previous slice
+#define LOCKSTEP_SLICE_RECORDS 65536
+
+std::vector<proc_config_t> build_config_grid(const std::vector<uint64_t>& result_bus_values,
+                                             const std::vector<uint64_t>& fu_type0_values,
+                                             const std::vector<uint64_t>& fu_type1_values,
+                                             const std::vector<uint64_t>& fu_type2_values,
+                                             const std::vector<uint64_t>& fetch_width_values)
+{
+    std::vector<proc_config_t> configs;
+    for (uint64_t r : result_bus_values) {
+        for (uint64_t k0 : fu_type0_values) {
+            for (uint64_t k1 : fu_type1_values) {
+                for (uint64_t k2 : fu_type2_values) {
+                    for (uint64_t f : fetch_width_values) {
+                        proc_config_t config;
+                        config.result_buses = r;
+                        config.fu_type0 = k0;
+                        config.fu_type1 = k1;
+                        config.fu_type2 = k2;
+                        config.fetch_width = f;
+                        config.architectural_registers = DEFAULT_ARCH_REGS;
+                        config.watchdog_cycles = DEFAULT_WATCHDOG_CYCLES;
+                        for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+                            config.fu_latency[functional_unit_type_id] = DEFAULT_FU_LATENCY;
+                            config.fu_pipelined[functional_unit_type_id] = false;
+                        }
+                        configs.push_back(config);
+                    }
+                }
+            }
+        }
+    }
+    return configs;
+}
+
+bool parse_fu_latency_list(const char* argument, uint64_t latencies[3], bool pipelined[3])
+{
+    const char* cursor = argument;
+    for (int functional_unit_type_id = 0; functional_unit_type_id < 3; functional_unit_type_id++) {
+        char* value_end;
+        latencies[functional_unit_type_id] = strtoull(cursor, &value_end, 10);
+        if (value_end == cursor || latencies[functional_unit_type_id] < 1 || latencies[functional_unit_type_id] > MAX_FU_LATENCY) {
+            return false;
+        }
+        pipelined[functional_unit_type_id] = (*value_end == 'p');
+        if (pipelined[functional_unit_type_id]) value_end++;
+        if (*value_end != (functional_unit_type_id < 2 ? ',' : '\0')) return false;
+        cursor = value_end + 1;
+    }
+    return true;
+}
+
+// Simulates a single configuration from the start of the shared trace
+static void simulate_config(const trace_record_t* trace_records, uint64_t trace_length,
+                            const proc_config_t& config, sweep_result_t* p_result)
+{
+    memory_trace_source source(trace_records, trace_length);
+    proc_sim_t simulator(config, &source);
+
+    memset(&p_result->stats, 0, sizeof(proc_stats_t));
+    simulator.run(&p_result->stats);
+    simulator.complete(&p_result->stats);
+    p_result->watchdog_expired = simulator.watchdog_expired();
+}
+
+//
+// for_each_index_in_parallel
+//
+//  Calls visitor(i) for every i in [0, count) on thread_count worker
+//  threads (0 selects one per hardware thread); workers claim indices one
+//  at a time so long runs balance out
+//
+template <typename visitor_t>
+static void for_each_index_in_parallel(size_t count, unsigned thread_count, visitor_t visitor)
+{
+    if (thread_count == 0) {
+        thread_count = std::thread::hardware_concurrency();
+        if (thread_count == 0) thread_count = 1;
+    }
+    if (thread_count > count) thread_count = count;
+
+    std::atomic<size_t> next_index(0);
+    auto worker = [&]() {
+        size_t index;
+        while ((index = next_index.fetch_add(1)) < count) {
+            visitor(index);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned thread_index = 1; thread_index < thread_count; thread_index++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& worker_thread : workers) {
+        worker_thread.join();
+    }
+}
+
+void run_parameter_sweep(const trace_record_t* trace_records, uint64_t trace_length,
+                         const std::vector<proc_config_t>& configs,
+                         std::vector<sweep_result_t>& results,
+                         unsigned thread_count)
+{
+    results.resize(configs.size());
+    for_each_index_in_parallel(configs.size(), thread_count, [&](size_t config_index) {
+        simulate_config(trace_records, trace_length, configs[config_index], &results[config_index]);
+    });
+}
+
+// Decoded records shared by a lockstep sweep; records[0] is trace record first_index
+typedef struct _lockstep_window_t
+{
+    std::deque<trace_record_t> records;
+    uint64_t first_index;
+    bool source_exhausted;
+} lockstep_window_t;
+
+//
+// lockstep_window_source
+//
+//  One configuration's view of the shared window. Positions are trace
+//  record indices, so deferred dispatch-queue instructions can be re-read
+//  while the window still holds them. The window is only extended between
+//  slices, so sources of different configurations read it concurrently.
+//
+class lockstep_window_source : public instruction_source
+{
+public:
+    explicit lockstep_window_source(const lockstep_window_t* window) : shared_window(window), next_index(0) {}
+
+    bool read(proc_inst_t* p_inst)
+    {
+        uint64_t window_end = shared_window->first_index + shared_window->records.size();
+        if (next_index == window_end) {
+            if (!shared_window->source_exhausted) {
+                fprintf(stderr, "Lockstep sweep fetched past its decoded window at record %llu\n",
+                        (unsigned long long)next_index);
+                exit(1);
+            }
+            return false;
+        }
+        trace_record_to_instruction(shared_window->records[next_index - shared_window->first_index], p_inst);
+        next_index++;
+        return true;
+    }
+
+    bool tell(uint64_t* p_position)
+    {
+        *p_position = next_index;
+        return true;
+    }
+
+    bool seek(uint64_t position)
+    {
+        if (position < shared_window->first_index ||
+            position > shared_window->first_index + shared_window->records.size()) {
+            return false;
+        }
+        next_index = position;
+        return true;
+    }
+
+    uint64_t position() const { return next_index; }
+
+private:
+    const lockstep_window_t* shared_window;
+    uint64_t next_index;
+};
+
+bool run_lockstep_sweep(instruction_source* source, const std::vector<proc_config_t>& configs,
+                        std::vector<sweep_result_t>& results, unsigned thread_count)
+{
+    size_t config_count = configs.size();
+    results.resize(config_count);
+
+    lockstep_window_t window;
+    window.first_index = 0;
+    window.source_exhausted = false;
+
+    // Per-configuration state, one array per field
+    std::vector<std::unique_ptr<lockstep_window_source> > window_sources(config_count);
+    std::vector<std::unique_ptr<proc_sim_t> > simulators(config_count);
+    std::vector<uint64_t> fetch_widths(config_count);
+    std::vector<uint8_t> finished(config_count, 0);
+    std::vector<size_t> running_indices;
+    uint64_t widest_fetch = 0;
+    for (size_t config_index = 0; config_index < config_count; config_index++) {
+        window_sources[config_index].reset(new lockstep_window_source(&window));
+        simulators[config_index].reset(new proc_sim_t(configs[config_index], window_sources[config_index].get()));
+        fetch_widths[config_index] = configs[config_index].fetch_width;
+        memset(&results[config_index].stats, 0, sizeof(proc_stats_t));
+        widest_fetch = std::max(widest_fetch, fetch_widths[config_index]);
+        running_indices.push_back(config_index);
+    }
+
+    uint64_t slice_end = 0;
+    proc_inst_t inst;
+    memset(&inst, 0, sizeof(inst));
+    while (!running_indices.empty()) {
+        // Decode through the slice plus one fetch group, the furthest any configuration reads ahead of it
+        slice_end += LOCKSTEP_SLICE_RECORDS;
+        while (!window.source_exhausted && window.first_index + window.records.size() < slice_end + widest_fetch) {
+            trace_record_t record;
+            if (!source->read(&inst)) {
+                window.source_exhausted = true;
+                break;
+            }
+            if (!instruction_to_trace_record(inst, &record)) return false;
+            window.records.push_back(record);
+        }
+
+        // Fetch reads exactly F records per cycle, so each configuration pauses at the cycle that
+        // reaches the slice end; once the trace is fully decoded they all run to completion
+        for_each_index_in_parallel(running_indices.size(), thread_count, [&](size_t running_index) {
+            size_t config_index = running_indices[running_index];
+            uint64_t fetch_width = fetch_widths[config_index];
+            uint64_t last_cycle = (window.source_exhausted || fetch_width == 0) ? UINT64_MAX
+                                                                                : (slice_end + fetch_width - 1) / fetch_width;
+            if (simulators[config_index]->run_until(&results[config_index].stats, last_cycle)) {
+                finished[config_index] = 1;
+            }
+        });
+
+        // Drop the records no running configuration can fetch or re-read again
+        uint64_t retained_index = window.first_index + window.records.size();
+        size_t running_count = 0;
+        for (size_t config_index : running_indices) {
+            if (finished[config_index]) continue;
+            running_indices[running_count++] = config_index;
+            uint64_t deferred_position;
+            retained_index = std::min(retained_index, window_sources[config_index]->position());
+            if (simulators[config_index]->deferred_trace_start(&deferred_position)) {
+                retained_index = std::min(retained_index, deferred_position);
+            }
+        }
+        running_indices.resize(running_count);
+        window.records.erase(window.records.begin(), window.records.begin() + (retained_index - window.first_index));
+        window.first_index = retained_index;
+    }
+
+    for (size_t config_index = 0; config_index < config_count; config_index++) {
+        simulators[config_index]->complete(&results[config_index].stats);
+        results[config_index].watchdog_expired = simulators[config_index]->watchdog_expired();
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef PROCSIM_SWEEP_HPP
+#define PROCSIM_SWEEP_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "procsim.hpp"
+#include "procsim_trace.hpp"
+
+// Outcome of one configuration in a sweep
+typedef struct _sweep_result_t
+{
+    proc_stats_t stats;
+    bool watchdog_expired;   // Abandoned by the watchdog; stats cover the cycles run until then
+} sweep_result_t;
+
+// Builds the cross product of the per-parameter value lists
+std::vector<proc_config_t> build_config_grid(const std::vector<uint64_t>& result_bus_values,
+                                             const std::vector<uint64_t>& fu_type0_values,
+                                             const std::vector<uint64_t>& fu_type1_values,
+                                             const std::vector<uint64_t>& fu_type2_values,
+                                             const std::vector<uint64_t>& fetch_width_values);
+
+// Parses a -L argument: one latency per FU type, each optionally suffixed with p for a pipelined
+// unit (e.g. "1,3p,5"); false unless it holds three latencies in 1..MAX_FU_LATENCY
+bool parse_fu_latency_list(const char* argument, uint64_t latencies[3], bool pipelined[3]);
+
+//
+// run_parameter_sweep
+//
+//  Simulates every configuration against the same in-memory or mapped
+//  trace using thread_count worker threads (0 selects one per hardware
+//  thread); results[i] receives the outcome for configs[i]
+//
+void run_parameter_sweep(const trace_record_t* trace_records, uint64_t trace_length,
+                         const std::vector<proc_config_t>& configs,
+                         std::vector<sweep_result_t>& results,
+                         unsigned thread_count);
+
+//
+// run_lockstep_sweep
+//
+//  Simulates every configuration in a single streaming pass over source.
+//  Each instruction is decoded once into a window shared by all
+//  configurations, which advance in lockstep slices of the trace on
+//  thread_count worker threads (0 selects one per hardware thread). The
+//  window keeps only the records some configuration may still fetch or
+//  re-read, so the trace is never held whole. Returns false if the trace
+//  has an instruction that does not fit a trace_record_t.
+//
+bool run_lockstep_sweep(instruction_source* source, const std::vector<proc_config_t>& configs,
+                        std::vector<sweep_result_t>& results, unsigned thread_count);
+
+#endif /* PROCSIM_SWEEP_HPP */
@@ -0,0 +1,96 @@
+#include "procsim_synth.hpp"
+#include <cmath>
+
+// Address of the first generated instruction
+#define SYNTHETIC_TRACE_BASE_ADDRESS 0x400000
+
+void default_synthetic_trace_config(synthetic_trace_config_t* p_config)
+{
+    p_config->seed = 1;
+    p_config->op_code_weight[0] = 1.0;
+    p_config->op_code_weight[1] = 1.0;
+    p_config->op_code_weight[2] = 1.0;
+    p_config->op_code_weight[3] = 1.0;
+    p_config->register_count = 32;
+    p_config->mean_dependency_distance = 4.0;
+    p_config->unused_source_fraction = 0.1;
+    p_config->unused_dest_fraction = 0.05;
+}
+
+synthetic_trace_generator_t::synthetic_trace_generator_t(const synthetic_trace_config_t& trace_config)
+    : config(trace_config), random_state(trace_config.seed), instruction_index(0), next_dest_reg(0)
+{
+    double total_weight = 0;
+    for (int op_index = 0; op_index < 4; op_index++) total_weight += config.op_code_weight[op_index];
+
+    double cumulative_weight = 0;
+    for (int op_index = 0; op_index < 4; op_index++) {
+        cumulative_weight += config.op_code_weight[op_index];
+        op_code_threshold[op_index] = cumulative_weight / total_weight;
+    }
+    op_code_threshold[3] = 1.0;
+
+    recent_dest_regs.assign(config.register_count, -1);
+}
+
+// splitmix64
+uint64_t synthetic_trace_generator_t::next_random()
+{
+    uint64_t z = (random_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+double synthetic_trace_generator_t::next_unit()
+{
+    return (double)(next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void synthetic_trace_generator_t::next(trace_record_t* p_record)
+{
+    p_record->instruction_address = (uint32_t)(SYNTHETIC_TRACE_BASE_ADDRESS + 4 * instruction_index);
+
+    double op_draw = next_unit();
+    int op_index = 0;
+    while (op_draw >= op_code_threshold[op_index]) op_index++;
+    p_record->op_code = op_index == 3 ? -1 : op_index;
+
+    uint64_t history_length = config.register_count;
+    for (int i = 0; i < 2; i++) {
+        p_record->src_reg[i] = -1;
+        if (next_unit() < config.unused_source_fraction) continue;
+
+        // Geometric distance >= 1 with the configured mean, kept inside the rewrite window
+        uint64_t distance = 1;
+        if (config.mean_dependency_distance > 1.0) {
+            double continue_probability = 1.0 - 1.0 / config.mean_dependency_distance;
+            distance += (uint64_t)(std::log(1.0 - next_unit()) / std::log(continue_probability));
+        }
+        if (distance < history_length && distance <= instruction_index) {
+            p_record->src_reg[i] = recent_dest_regs[(instruction_index - distance) % history_length];
+        }
+        if (p_record->src_reg[i] == -1) {
+            // No producer at that distance: read any register
+            p_record->src_reg[i] = (int16_t)(next_random() % config.register_count);
+        }
+    }
+
+    p_record->dest_reg = -1;
+    if (next_unit() >= config.unused_dest_fraction) {
+        p_record->dest_reg = (int16_t)next_dest_reg;
+        next_dest_reg = (next_dest_reg + 1) % config.register_count;
+    }
+    recent_dest_regs[instruction_index % history_length] = p_record->dest_reg;
+    instruction_index++;
+}
+
+void generate_synthetic_trace(const synthetic_trace_config_t& config, uint64_t record_count, std::vector<trace_record_t>& trace)
+{
+    synthetic_trace_generator_t generator(config);
+    trace.resize(record_count);
+    for (uint64_t index = 0; index < record_count; index++) {
+        generator.next(&trace[index]);
+    }
+}
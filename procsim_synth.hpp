@@ -0,0 +1,61 @@
+#ifndef PROCSIM_SYNTH_HPP
+#define PROCSIM_SYNTH_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "procsim_trace.hpp"
+
+// Shape of a synthetic trace
+typedef struct _synthetic_trace_config_t
+{
+    uint64_t seed;
+    // Relative weights of op_code 0, 1, 2 and -1
+    double op_code_weight[4];
+    // Registers written round-robin; must be at least 2
+    uint64_t register_count;
+    // Mean distance in instructions from a source operand to its producer
+    double mean_dependency_distance;
+    // Fraction of source operands that read no register (-1)
+    double unused_source_fraction;
+    // Fraction of instructions that write no register (-1)
+    double unused_dest_fraction;
+} synthetic_trace_config_t;
+
+// Defaults: an even op mix over 32 registers with producers about 4 instructions back
+void default_synthetic_trace_config(synthetic_trace_config_t* p_config);
+
+//
+// synthetic_trace_generator_t
+//
+//  Produces trace records one at a time, so a trace of any length is
+//  streamed without being held in memory. Destination registers rotate
+//  round-robin, so a register is rewritten only every register_count
+//  instructions and a source drawn at distance d < register_count depends
+//  on exactly the instruction d back. Distances follow a geometric
+//  distribution with the configured mean.
+//
+class synthetic_trace_generator_t
+{
+public:
+    explicit synthetic_trace_generator_t(const synthetic_trace_config_t& config);
+
+    void next(trace_record_t* p_record);
+
+private:
+    uint64_t next_random();
+    double next_unit();
+
+    synthetic_trace_config_t config;
+    double op_code_threshold[4];
+    uint64_t random_state;
+    uint64_t instruction_index;
+    uint64_t next_dest_reg;
+    // Destination register of each of the last register_count instructions, -1 if none
+    std::vector<int16_t> recent_dest_regs;
+};
+
+// Fills trace with record_count generated records
+void generate_synthetic_trace(const synthetic_trace_config_t& config, uint64_t record_count, std::vector<trace_record_t>& trace);
+
+#endif /* PROCSIM_SYNTH_HPP */
@@ -0,0 +1,172 @@
+#include "procsim_trace.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Returns true if value is representable in a trace_record_t field
+static bool fits_record_field(int value)
+{
+    return value >= INT16_MIN && value <= INT16_MAX;
+}
+
+bool read_text_trace_record(FILE* trace_file, trace_record_t* p_record, bool* p_malformed)
+{
+    uint32_t instruction_address;
+    int op_code, dest_reg, src_reg0, src_reg1;
+
+    if (p_malformed != NULL) *p_malformed = false;
+
+    int ret = fscanf(trace_file, "%x %d %d %d %d\n", &instruction_address,
+                     &op_code, &dest_reg, &src_reg0, &src_reg1);
+    if (ret != 5) {
+        return false;
+    }
+
+    if (!fits_record_field(op_code) || !fits_record_field(dest_reg) ||
+        !fits_record_field(src_reg0) || !fits_record_field(src_reg1)) {
+        fprintf(stderr, "Trace instruction %x has a field outside the 16-bit record range\n", instruction_address);
+        if (p_malformed != NULL) *p_malformed = true;
+        return false;
+    }
+
+    p_record->instruction_address = instruction_address;
+    p_record->op_code = op_code;
+    p_record->dest_reg = dest_reg;
+    p_record->src_reg[0] = src_reg0;
+    p_record->src_reg[1] = src_reg1;
+    return true;
+}
+
+bool instruction_to_trace_record(const proc_inst_t& inst, trace_record_t* p_record)
+{
+    if (!fits_record_field(inst.op_code) || !fits_record_field(inst.dest_reg) ||
+        !fits_record_field(inst.src_reg[0]) || !fits_record_field(inst.src_reg[1])) {
+        fprintf(stderr, "Trace instruction %x has a field outside the 16-bit record range\n", inst.instruction_address);
+        return false;
+    }
+
+    p_record->instruction_address = inst.instruction_address;
+    p_record->op_code = inst.op_code;
+    p_record->dest_reg = inst.dest_reg;
+    p_record->src_reg[0] = inst.src_reg[0];
+    p_record->src_reg[1] = inst.src_reg[1];
+    return true;
+}
+
+bool load_text_trace(FILE* trace_file, std::vector<trace_record_t>& trace)
+{
+    trace_record_t record;
+    bool malformed;
+    while (read_text_trace_record(trace_file, &record, &malformed)) {
+        trace.push_back(record);
+    }
+    return !malformed;
+}
+
+bool convert_text_trace_to_binary(FILE* text_file, FILE* binary_file)
+{
+    binary_trace_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC));
+    header.version = BINARY_TRACE_VERSION;
+    header.record_size = sizeof(trace_record_t);
+
+    // Reserve the header, the record count is patched in once known
+    if (fwrite(&header, sizeof(header), 1, binary_file) != 1) return false;
+
+    trace_record_t record;
+    bool malformed;
+    while (read_text_trace_record(text_file, &record, &malformed)) {
+        if (fwrite(&record, sizeof(record), 1, binary_file) != 1) return false;
+        header.record_count++;
+    }
+    if (malformed) return false;
+
+    if (fseek(binary_file, 0, SEEK_SET) != 0) return false;
+    if (fwrite(&header, sizeof(header), 1, binary_file) != 1) return false;
+    return fflush(binary_file) == 0;
+}
+
+bool is_binary_trace_file(const char* path)
+{
+    FILE* trace_file = fopen(path, "rb");
+    if (trace_file == NULL) return false;
+
+    binary_trace_header_t header;
+    bool has_header = fread(&header, sizeof(header), 1, trace_file) == 1 &&
+                      memcmp(header.magic, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC)) == 0;
+    fclose(trace_file);
+    return has_header;
+}
+
+bool mapped_trace_t::open(const char* path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s for reading\n", path);
+        return false;
+    }
+
+    struct stat file_status;
+    if (fstat(fd, &file_status) != 0 || (size_t)file_status.st_size < sizeof(binary_trace_header_t)) {
+        fprintf(stderr, "%s is too short to be a binary trace\n", path);
+        ::close(fd);
+        return false;
+    }
+
+    mapping_length = file_status.st_size;
+    mapping_base = mmap(NULL, mapping_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping_base == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s\n", path);
+        mapping_base = NULL;
+        mapping_length = 0;
+        return false;
+    }
+
+    const binary_trace_header_t* header = (const binary_trace_header_t*)mapping_base;
+    uint64_t payload_length = mapping_length - sizeof(binary_trace_header_t);
+    if (memcmp(header->magic, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC)) != 0 ||
+        header->version != BINARY_TRACE_VERSION ||
+        header->record_size != sizeof(trace_record_t) ||
+        header->record_count > payload_length / sizeof(trace_record_t)) {
+        fprintf(stderr, "%s is not a valid binary trace\n", path);
+        close();
+        return false;
+    }
+
+    // Records are replayed front to back exactly once per simulation
+    madvise(mapping_base, mapping_length, MADV_SEQUENTIAL);
+
+    trace_records = (const trace_record_t*)(header + 1);
+    trace_length = header->record_count;
+    return true;
+}
+
+void mapped_trace_t::close()
+{
+    if (mapping_base != NULL) {
+        munmap(mapping_base, mapping_length);
+    }
+    mapping_base = NULL;
+    mapping_length = 0;
+    trace_records = NULL;
+    trace_length = 0;
+}
+
+bool file_trace_source::tell(uint64_t* p_position)
+{
+    off_t offset = ftello(trace_file);
+    if (offset < 0) return false;
+    *p_position = (uint64_t)offset;
+    return true;
+}
+
+bool file_trace_source::seek(uint64_t position)
+{
+    return fseeko(trace_file, (off_t)position, SEEK_SET) == 0;
+}
@@ -0,0 +1,152 @@
+#ifndef PROCSIM_TRACE_HPP
+#define PROCSIM_TRACE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "procsim.hpp"
+
+// Trace fields of a single instruction; also the on-disk binary record
+typedef struct _trace_record_t
+{
+    uint32_t instruction_address;
+    int16_t op_code;
+    int16_t dest_reg;
+    int16_t src_reg[2];
+} trace_record_t;
+
+//
+// Binary trace layout (host byte order, little-endian on every supported
+// target): a binary_trace_header_t followed by record_count packed
+// trace_record_t entries
+//
+#define BINARY_TRACE_MAGIC "PSIMBTR"
+#define BINARY_TRACE_VERSION 1
+
+typedef struct _binary_trace_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t record_count;
+} binary_trace_header_t;
+
+// Parses one "%x %d %d %d %d" text trace line, returns false at end of input
+// or on a line that does not fit a trace_record_t (p_malformed is then set)
+bool read_text_trace_record(FILE* trace_file, trace_record_t* p_record, bool* p_malformed = NULL);
+
+// Reads an entire text trace into memory, returns false on a malformed line
+bool load_text_trace(FILE* trace_file, std::vector<trace_record_t>& trace);
+
+// Streams a text trace into the binary format, returns false on error
+bool convert_text_trace_to_binary(FILE* text_file, FILE* binary_file);
+
+// Returns true if the file at path starts with a binary trace header
+bool is_binary_trace_file(const char* path);
+
+// Copies the trace fields of a record into an instruction
+inline void trace_record_to_instruction(const trace_record_t& record, proc_inst_t* p_inst)
+{
+    p_inst->instruction_address = record.instruction_address;
+    p_inst->op_code = record.op_code;
+    p_inst->dest_reg = record.dest_reg;
+    p_inst->src_reg[0] = record.src_reg[0];
+    p_inst->src_reg[1] = record.src_reg[1];
+}
+
+// Copies the trace fields of an instruction into a record, returns false if a field does not fit
+bool instruction_to_trace_record(const proc_inst_t& inst, trace_record_t* p_record);
+
+//
+// mapped_trace_t
+//
+//  Read-only memory mapping of a binary trace; records() points straight
+//  into the mapping, so nothing is parsed or copied up front
+//
+class mapped_trace_t
+{
+public:
+    mapped_trace_t() : mapping_base(NULL), mapping_length(0), trace_records(NULL), trace_length(0) {}
+    ~mapped_trace_t() { close(); }
+
+    bool open(const char* path);
+    void close();
+
+    const trace_record_t* records() const { return trace_records; }
+    uint64_t size() const { return trace_length; }
+
+private:
+    mapped_trace_t(const mapped_trace_t&);
+    mapped_trace_t& operator=(const mapped_trace_t&);
+
+    void* mapping_base;
+    size_t mapping_length;
+    const trace_record_t* trace_records;
+    uint64_t trace_length;
+};
+
+//
+// memory_trace_source
+//
+//  Replays an in-memory or mapped trace; the records are shared read-only,
+//  so any number of simulator instances may replay the same trace
+//  concurrently
+//
+class memory_trace_source : public instruction_source
+{
+public:
+    memory_trace_source(const trace_record_t* records, uint64_t record_count)
+        : trace_records(records), trace_length(record_count), next_record_index(0) {}
+
+    bool read(proc_inst_t* p_inst)
+    {
+        if (next_record_index >= trace_length) return false;
+        trace_record_to_instruction(trace_records[next_record_index++], p_inst);
+        return true;
+    }
+
+    bool tell(uint64_t* p_position)
+    {
+        *p_position = next_record_index;
+        return true;
+    }
+
+    bool seek(uint64_t position)
+    {
+        if (position > trace_length) return false;
+        next_record_index = position;
+        return true;
+    }
+
+private:
+    const trace_record_t* trace_records;
+    uint64_t trace_length;
+    uint64_t next_record_index;
+};
+
+//
+// file_trace_source
+//
+//  Parses a text trace from a seekable file exactly as read_instruction
+//  does; positions are byte offsets
+//
+class file_trace_source : public instruction_source
+{
+public:
+    explicit file_trace_source(FILE* text_file) : trace_file(text_file) {}
+
+    bool read(proc_inst_t* p_inst)
+    {
+        return fscanf(trace_file, "%x %d %d %d %d\n", &p_inst->instruction_address, &p_inst->op_code,
+                      &p_inst->dest_reg, &p_inst->src_reg[0], &p_inst->src_reg[1]) == 5;
+    }
+
+    bool tell(uint64_t* p_position);
+    bool seek(uint64_t position);
+
+private:
+    FILE* trace_file;
+};
+
+#endif /* PROCSIM_TRACE_HPP */
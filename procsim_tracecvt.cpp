@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "procsim_ctrace.hpp"
+#include "procsim_trace.hpp"
+
+//
+// procsim_tracecvt
+//
+//  Converts a text trace ("%x %d %d %d %d" per line) into the packed binary
+//  trace format that procsim maps with -i, or with -z into the compressed
+//  trace format that procsim streams with -i
+//
+int main(int argc, char* argv[]) {
+    bool write_compressed = argc > 1 && strcmp(argv[1], "-z") == 0;
+    if (write_compressed) {
+        argc--;
+        argv++;
+    }
+    if (argc != 3) {
+        printf("procsim_tracecvt [-z] input.trace output.btrace\n");
+        printf("  -z\tWrite the compressed trace format instead of the binary one\n");
+        printf("  Use - as input to read the text trace from stdin\n");
+        return 1;
+    }
+
+    FILE* text_file = stdin;
+    if (argv[1][0] != '-' || argv[1][1] != '\0') {
+        text_file = fopen(argv[1], "r");
+        if (text_file == NULL) {
+            fprintf(stderr, "Failed to open %s for reading\n", argv[1]);
+            return 1;
+        }
+    }
+
+    FILE* binary_file = fopen(argv[2], "wb");
+    if (binary_file == NULL) {
+        fprintf(stderr, "Failed to open %s for writing\n", argv[2]);
+        return 1;
+    }
+
+    // Large stdio buffers keep the conversion streaming at disk speed
+    setvbuf(text_file, NULL, _IOFBF, 1 << 20);
+    setvbuf(binary_file, NULL, _IOFBF, 1 << 20);
+
+    bool converted = write_compressed ? convert_text_trace_to_compressed(text_file, binary_file)
+                                      : convert_text_trace_to_binary(text_file, binary_file);
+    if (!converted) {
+        fprintf(stderr, "Failed to convert %s\n", argv[1]);
+        fclose(binary_file);
+        remove(argv[2]);
+        return 1;
+    }
+
+    fclose(binary_file);
+    return 0;
+}
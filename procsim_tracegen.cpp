@@ -0,0 +1,148 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "procsim_ctrace.hpp"
+#include "procsim_synth.hpp"
+
+//
+// procsim_tracegen
+//
+//  Streams a synthetic trace in the text format read_instruction consumes
+//  or in the binary or compressed trace formats, one record at a time
+//
+
+// Parses "w0,w1,w2,w-1" into the four op_code weights
+static bool parse_op_mix(const char* text, double* weights)
+{
+    char* end;
+    for (int op_index = 0; op_index < 4; op_index++) {
+        weights[op_index] = strtod(text, &end);
+        if (end == text || weights[op_index] < 0) return false;
+        if (op_index < 3) {
+            if (*end != ',') return false;
+            text = end + 1;
+        }
+    }
+    return *end == '\0' && weights[0] + weights[1] + weights[2] + weights[3] > 0;
+}
+
+void print_help_and_exit(void) {
+    printf("procsim_tracegen [OPTIONS] output\n");
+    printf("  -n length\tInstructions to generate (default 1000000)\n");
+    printf("  -m w0,w1,w2,w3\tRelative weights of op_code 0, 1, 2 and -1 (default 1,1,1,1)\n");
+    printf("  -a regs\tRegisters used, 2..32767; procsim needs -a if above 128 (default 32)\n");
+    printf("  -d mean\tMean dependency distance in instructions (default 4)\n");
+    printf("  -u frac\tFraction of source operands without a register (default 0.1)\n");
+    printf("  -x frac\tFraction of instructions without a destination (default 0.05)\n");
+    printf("  -s seed\tRandom seed (default 1)\n");
+    printf("  -b\t\tWrite the binary trace format instead of text\n");
+    printf("  -z\t\tWrite the compressed trace format instead of text\n");
+    printf("  -h\t\tThis helpful output\n");
+    printf("Use - as output to write to stdout\n");
+    exit(0);
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    uint64_t record_count = 1000000;
+    bool write_binary = false;
+    bool write_compressed = false;
+    synthetic_trace_config_t config;
+    default_synthetic_trace_config(&config);
+
+    while (-1 != (opt = getopt(argc, argv, "n:m:a:d:u:x:s:bzh"))) {
+        switch (opt) {
+        case 'n':
+            record_count = strtoull(optarg, NULL, 0);
+            break;
+        case 'm':
+            if (!parse_op_mix(optarg, config.op_code_weight)) {
+                fprintf(stderr, "Invalid op_code mix %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'a':
+            config.register_count = strtoull(optarg, NULL, 0);
+            break;
+        case 'd':
+            config.mean_dependency_distance = atof(optarg);
+            break;
+        case 'u':
+            config.unused_source_fraction = atof(optarg);
+            break;
+        case 'x':
+            config.unused_dest_fraction = atof(optarg);
+            break;
+        case 's':
+            config.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'b':
+            write_binary = true;
+            break;
+        case 'z':
+            write_compressed = true;
+            break;
+        case 'h':
+        default:
+            print_help_and_exit();
+            break;
+        }
+    }
+
+    if (optind != argc - 1 || (write_binary && write_compressed)) print_help_and_exit();
+    if (config.register_count < 2 || config.register_count > 32767) {
+        fprintf(stderr, "Register count must be between 2 and 32767\n");
+        return 1;
+    }
+    if (config.mean_dependency_distance < 1.0) {
+        fprintf(stderr, "Mean dependency distance must be at least 1\n");
+        return 1;
+    }
+
+    const char* output_path = argv[optind];
+    bool to_stdout = strcmp(output_path, "-") == 0;
+    FILE* trace_file = to_stdout ? stdout : fopen(output_path, write_binary || write_compressed ? "wb" : "w");
+    if (trace_file == NULL) {
+        fprintf(stderr, "Failed to open %s for writing\n", output_path);
+        return 1;
+    }
+    setvbuf(trace_file, NULL, _IOFBF, 1 << 20);
+
+    if (write_binary) {
+        // The length is known up front, so the header is written once and never patched
+        binary_trace_header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC));
+        header.version = BINARY_TRACE_VERSION;
+        header.record_size = sizeof(trace_record_t);
+        header.record_count = record_count;
+        fwrite(&header, sizeof(header), 1, trace_file);
+    }
+    compressed_trace_writer_t compressed_writer;
+    if (write_compressed) compressed_writer.open(trace_file);
+
+    synthetic_trace_generator_t generator(config);
+    trace_record_t record;
+    for (uint64_t index = 0; index < record_count && !ferror(trace_file); index++) {
+        generator.next(&record);
+        if (write_binary) {
+            fwrite(&record, sizeof(record), 1, trace_file);
+        } else if (write_compressed) {
+            compressed_writer.append(record);
+        } else {
+            fprintf(trace_file, "%x %d %d %d %d\n", record.instruction_address, record.op_code,
+                    record.dest_reg, record.src_reg[0], record.src_reg[1]);
+        }
+    }
+
+    bool write_ok = !write_compressed || compressed_writer.finish();
+    write_ok = !ferror(trace_file) && write_ok;
+    write_ok = (to_stdout ? fflush(trace_file) == 0 : fclose(trace_file) == 0) && write_ok;
+    if (!write_ok) {
+        fprintf(stderr, "Failed to write %s\n", output_path);
+        if (!to_stdout) remove(output_path);
+        return 1;
+    }
+    return 0;
+}